@@ -18,8 +18,17 @@
 #include "BranchManager.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
 #include "Settings.h"
+#include "InputCache.h"
+#include "EntryPipeline.h"
+#include "OutputClusters.h"
+#include "OutputCompression.h"
+#include "logging.h"
 
 
 using namespace std;
@@ -28,6 +37,36 @@ using namespace std;
 namespace froast {
 
 
+namespace {
+
+int32_t branchOutputParam(const char* branchName, const char* param, int32_t value, int32_t dflt) {
+	if (value >= 0) return value;
+	TString branchKey = TString::Format("froast.output.branch.%s.%s", branchName, param);
+	if (Settings::current().defined(branchKey.Data()))
+		return GSettings::get(branchKey.Data(), dflt, false);
+	return GSettings::get(TString::Format("froast.output.%s", param).Data(), dflt);
+}
+
+} // namespace
+
+
+BranchOutputParams BranchOutputParams::resolved(const char* branchName) const {
+	return BranchOutputParams(
+		branchOutputParam(branchName, "basket.size", basketSize, 32000),
+		branchOutputParam(branchName, "split.level", splitLevel, 0),
+		branchOutputParam(branchName, "compression.algorithm", compressionAlgorithm, -1),
+		branchOutputParam(branchName, "compression.level", compressionLevel, -1)
+	);
+}
+
+
+void BranchOutputParams::applyCompression(TBranch *branch) const {
+	if (compressionAlgorithm >= 0) branch->SetCompressionAlgorithm(compressionAlgorithm);
+	if (compressionLevel >= 0) branch->SetCompressionLevel(compressionLevel);
+}
+
+
+
 const TString& ManagedBranch::name() const {
 	if (m_names.empty()) throw invalid_argument("No branch name set");
 	return m_names.back();
@@ -44,6 +83,33 @@ ManagedBranch& ManagedBranch::addName(const TString &branchName) {
 	return *this;
 }
 
+void ManagedBranch::updateInputBranch(TTree *tree) {
+	if (!m_inAvail) return;
+	m_inBranch = tree->GetBranch(m_inBranchName.Data());
+	m_loadedEntry = -1;
+}
+
+
+void ManagedBranch::lazyInput(const Long64_t *entry) {
+	m_lazyEntry = entry;
+	m_loadedEntry = -1;
+}
+
+
+void ManagedBranch::loadEntry() const {
+	m_loadedEntry = *m_lazyEntry;
+	if (m_inBranch != 0) {
+		m_inBranch->GetEntry(m_loadedEntry);
+		++m_nLazyLoads;
+	}
+}
+
+
+ManagedBranch& ManagedBranch::outputParams(const BranchOutputParams &params) {
+	m_outParams = params;
+	return *this;
+}
+
 ManagedBranch& ManagedBranch::addTo(BranchManager &manager) {
     manager.add(*this);
 	return *this;
@@ -59,14 +125,21 @@ ManagedBranch& ManagedBranch::outputTo(OutputBranchManager &manager, int32_t out
 	return *this;
 }
 
+ManagedBranch& ManagedBranch::outputTo(OutputBranchManager &manager, int32_t outputLevel, const BranchOutputParams &params) {
+	manager.add(*this, outputLevel, params);
+	return *this;
+}
+
 
 ManagedBranch::ManagedBranch()
-	: m_inAvail(false)
+	: m_inAvail(false), m_addrInUse(false),
+	  m_inBranch(0), m_lazyEntry(0), m_loadedEntry(-1), m_nLazyLoads(0)
 {}
 
 
 ManagedBranch::ManagedBranch(const TString &branchName)
-	: m_inAvail(false)
+	: m_inAvail(false), m_addrInUse(false),
+	  m_inBranch(0), m_lazyEntry(0), m_loadedEntry(-1), m_nLazyLoads(0)
 {
 	m_names.push_back(branchName);
 }
@@ -76,29 +149,131 @@ ManagedBranch::~ManagedBranch() {}
 
 
 
+namespace {
+
+bool largerValueFirst(ManagedBranch *a, ManagedBranch *b)
+	{ return a->valueSize() > b->valueSize(); }
+
+
+// Sets basket sizes of branch and sub-branches, returns number of baskets changed
+int setTunedBasketSize(TBranch *branch, Long64_t nEntries, Long64_t clusterEntries, Int_t maxBasketSize) {
+	TObjArray *subBranches = branch->GetListOfBranches();
+	if ((subBranches != 0) && (subBranches->GetEntriesFast() > 0)) {
+		int n = 0;
+		for (Int_t i = 0; i < subBranches->GetEntriesFast(); ++i) {
+			TBranch *sub = dynamic_cast<TBranch*>(subBranches->At(i));
+			if (sub != 0) n += setTunedBasketSize(sub, nEntries, clusterEntries, maxBasketSize);
+		}
+		return n;
+	} else {
+		const Int_t minBasketSize = 1024;
+		double entryBytes = double(branch->GetTotBytes()) / double(nEntries);
+		// Allow for the entry offset table of variable-size entries:
+		double basketSize = (entryBytes + sizeof(Int_t)) * double(clusterEntries) + minBasketSize;
+		Int_t size = Int_t(std::max(double(minBasketSize), std::min(double(maxBasketSize), basketSize)));
+		branch->SetBasketSize(size);
+		log_trace("Setting basket size of branch \"%s\" to %li bytes", branch->GetName(), (long)size);
+		return 1;
+	}
+}
+
+} // namespace
+
+
+void BranchValueStore::add(ManagedBranch &branch) {
+	switch (branch.valueKind()) {
+		case ManagedBranch::VK_SCALAR:
+			if (!m_laidOut) m_pending.push_back(&branch);
+			else m_generic.push_back(&branch);
+			break;
+		case ManagedBranch::VK_VECTOR:
+			m_vectors.push_back(VectorRef(branch.valueAddress(), branch.clearFunction()));
+			break;
+		case ManagedBranch::VK_FIXED:
+			break;
+		default:
+			m_generic.push_back(&branch);
+	}
+}
+
+
+void BranchValueStore::layout() {
+	if (m_laidOut) return;
+	m_laidOut = true;
+	if (m_pending.empty()) return;
+
+	// Largest values first, so natural alignment requires no padding:
+	std::stable_sort(m_pending.begin(), m_pending.end(), largerValueFirst);
+
+	const size_t cacheLine = 64;
+	size_t size = 0;
+	for (size_t i = 0; i < m_pending.size(); ++i) size += m_pending[i]->valueSize();
+	size = (size + cacheLine - 1) / cacheLine * cacheLine;
+
+	void *arena = 0;
+	if (posix_memalign(&arena, cacheLine, size) != 0) throw bad_alloc();
+	memset(arena, 0, size);
+	m_arena = static_cast<char*>(arena);
+	m_arenaSize = size;
+
+	size_t offset = 0;
+	for (size_t i = 0; i < m_pending.size(); ++i) {
+		ManagedBranch *branch = m_pending[i];
+		if (branch->relocateValue(m_arena + offset)) offset += branch->valueSize();
+		else m_inPlace.push_back(ScalarRef(branch->valueAddress(), branch->valueSize()));
+	}
+	m_pending.clear();
+}
+
+
+void BranchValueStore::clear() {
+	if (!m_laidOut) layout();
+	if (m_arena != 0) memset(m_arena, 0, m_arenaSize);
+	for (std::vector<ScalarRef>::iterator it = m_inPlace.begin(); it != m_inPlace.end(); ++it)
+		memset(it->value, 0, it->size);
+	for (std::vector<VectorRef>::iterator it = m_vectors.begin(); it != m_vectors.end(); ++it)
+		it->clear(it->value);
+	for (std::vector<ManagedBranch*>::iterator it = m_generic.begin(); it != m_generic.end(); ++it)
+		(**it).clear();
+}
+
+
+BranchValueStore::BranchValueStore()
+	: m_arena(0), m_arenaSize(0), m_laidOut(false)
+{}
+
+
+BranchValueStore::~BranchValueStore() {
+	if (m_arena != 0) ::free(m_arena);
+}
+
+
+
 void BranchManager::add(ManagedBranch &branch) {
 	m_branches.push_back(&branch);
+	m_values.add(branch);
 }
 
 
 void BranchManager::inputFrom(TTree *tree) {
-	int inputCacheSize = GSettings::get("froast.input.ttree.cache", -1);
-	tree->SetCacheSize(inputCacheSize);
+	InputCache::prepare(tree);
 	tree->SetBranchStatus("*", false);
-	for (std::list<ManagedBranch*>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+	m_values.layout();
+	for (std::vector<ManagedBranch*>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
 		(**it).inputFrom(tree);
+	InputCache::adapt(tree, 1);
 }
 
 
 void BranchManager::outputTo(TTree *tree) {
-	for (std::list<ManagedBranch*>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+	m_values.layout();
+	for (std::vector<ManagedBranch*>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
 		(**it).outputTo(tree);
 }
 
 
 void BranchManager::clearData() {
-	for (std::list<ManagedBranch*>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
-		(**it).clear();
+	m_values.clear();
 }
 
 
@@ -109,51 +284,216 @@ BranchManager::~BranchManager() {}
 
 
 
+void InputBranchManager::learn() {
+	if (++m_nEntries <= m_learnEntries) return;
+	m_learned = true;
+	applyLearned();
+}
+
+
+void InputBranchManager::applyLearned() {
+	int nUsed = 0;
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it) {
+		const ManagedBranch &branch = *it->branch;
+		if ((branch.lazyLoads() > 0) && (branch.inputBranch() != 0)) {
+			m_tree->AddBranchToCache(branch.inputBranch(), true);
+			++nUsed;
+		}
+	}
+	m_tree->StopCacheLearningPhase();
+	log_debug("Lazy input: %i of %i branches accessed during the first %lli entries, added to TTreeCache",
+		nUsed, int(m_branches.size()), (long long)m_learnEntries);
+}
+
+
 void InputBranchManager::add(ManagedBranch &branch, bool optional) {
 	m_branches.push_back(BranchSpec(&branch, optional));
+	m_values.add(branch);
 }
 
 
 void InputBranchManager::inputFrom(TTree *tree) {
-	int inputCacheSize = GSettings::get("froast.input.ttree.cache", -1);
-	tree->SetCacheSize(inputCacheSize);
+	InputCache::prepare(tree);
 	tree->SetBranchStatus("*", false);
-	for (std::list<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+	m_values.layout();
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
 		it->branch->inputFrom(tree, 0, it->optional);
+
+	m_tree = tree;
+	static Setting<bool> lazy("froast.input.lazy", false);
+	static Setting<int32_t> learnEntries("froast.input.lazy.learn.entries", 100);
+	static Setting<bool> pipeline("froast.input.pipeline", false);
+
+	m_lazy = lazy;
+	m_learnEntries = learnEntries;
+	m_nEntries = 0;
+	m_learned = !m_lazy;
+	m_entry = -1;
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+		it->branch->lazyInput(m_lazy ? &m_entry : 0);
+
+	delete m_pipeline;
+	m_pipeline = 0;
+	if (!m_lazy && pipeline) {
+		std::vector<ManagedBranch*> available;
+		inputBranches(available);
+		if (EntryPipeline::supported(tree, available)) m_pipeline = new EntryPipeline(tree, available);
+	}
+
+	if (m_pipeline != 0) {
+		// Entries are read by the pipeline's own tree, which has its own cache
+		tree->SetCacheSize(0);
+		return;
+	}
+	// Let the TTreeCache learn from the branches actually accessed:
+	if (m_lazy) tree->DropBranchFromCache("*", true);
+	// All branches have been added to the cache explicitly, unless lazy:
+	InputCache::adapt(tree, m_lazy ? Int_t(m_learnEntries) : 1);
+}
+
+
+void InputBranchManager::notify() {
+	if (m_tree == 0) return;
+	TTree *current = m_tree->GetTree();
+	if (current == 0) return;
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+		it->branch->updateInputBranch(current);
+	if (m_pipeline != 0) return;
+	InputCache::adapt(m_tree);
+	if (m_lazy && m_learned) applyLearned();
+}
+
+
+void InputBranchManager::inputBranches(std::vector<ManagedBranch*> &branches, bool availableOnly) const {
+	for (std::vector<BranchSpec>::const_iterator it = m_branches.begin(); it != m_branches.end(); ++it)
+		if (!availableOnly || it->branch->inputAvailable()) branches.push_back(it->branch);
+}
+
+
+void InputBranchManager::fetchEntry(Long64_t entry) {
+	if (m_pipeline == 0) throw std::logic_error("InputBranchManager::fetchEntry() called without input pipeline");
+	m_pipeline->fetch(entry);
+}
+
+
+void InputBranchManager::finish() {
+	if (m_pipeline != 0) m_pipeline->finish();
 }
 
 
 void InputBranchManager::clearData() {
-	for (std::list<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
-		it->branch->clear();
+	m_values.clear();
 }
 
 
-InputBranchManager::InputBranchManager() {}
+InputBranchManager::InputBranchManager()
+	: m_tree(0), m_lazy(false), m_entry(-1), m_learnEntries(0), m_nEntries(0), m_learned(true), m_pipeline(0)
+{}
 
 
-InputBranchManager::~InputBranchManager() {}
+InputBranchManager::~InputBranchManager() {
+	delete m_pipeline;
+}
 
 
 
+void OutputBranchManager::tuneBaskets() {
+	m_tuned = true;
+	Long64_t nEntries = m_tree->GetEntries();
+	if (nEntries <= 0) return;
+
+	double clusterBytes = GSettings::get("froast.output.cluster.size", 32.0) * 1024 * 1024;
+	Int_t maxBasketSize = GSettings::get("froast.output.basket.max", 16 * 1024 * 1024);
+
+	std::vector<TBranch*> branches;
+	double entryBytes = 0;
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it) {
+		if (it->outputLevel > m_maxOutputLevel) continue;
+		TBranch *branch = m_tree->GetBranch(it->branch->name().Data());
+		if (branch == 0) continue;
+		branches.push_back(branch);
+		entryBytes += double(branch->GetTotBytes("*")) / double(nEntries);
+	}
+	if (entryBytes <= 0) return;
+
+	Long64_t clusterEntries = std::max(Long64_t(1), Long64_t(clusterBytes / entryBytes));
+	int nTuned = 0;
+	for (std::vector<TBranch*>::iterator it = branches.begin(); it != branches.end(); ++it)
+		nTuned += setTunedBasketSize(*it, nEntries, clusterEntries, maxBasketSize);
+	// Cluster policies with a fixed number of entries take precedence
+	OutputClusters::Policy policy = OutputClusters::policy();
+	if ((policy == OutputClusters::CP_DEFAULT) || (policy == OutputClusters::CP_SIZE))
+		m_tree->SetAutoFlush(clusterEntries);
+
+	log_info("Tuned %i output baskets for %lli entries (%.1f bytes) per cluster, based on %lli entries",
+		nTuned, (long long)clusterEntries, entryBytes * clusterEntries, (long long)nEntries);
+}
+
+
+void OutputBranchManager::tuneCompression() {
+	std::vector<TBranch*> pending;
+	for (std::vector<TBranch*>::iterator it = m_autoCompress.begin(); it != m_autoCompress.end(); ++it) {
+		// Retry branches with too little unflushed data later:
+		if (OutputCompression::tune(*it) < 0) pending.push_back(*it);
+	}
+	m_autoCompress.swap(pending);
+	m_autoCompressNext = m_tree->GetEntriesFast() + m_autoCompressEntries;
+}
+
+
 void OutputBranchManager::add(ManagedBranch &branch, int32_t outputLevel) {
 	m_branches.push_back(BranchSpec(&branch, outputLevel));
+	m_values.add(branch);
+}
+
+
+void OutputBranchManager::add(ManagedBranch &branch, int32_t outputLevel, const BranchOutputParams &params) {
+	branch.outputParams(params);
+	add(branch, outputLevel);
 }
 
 
 void OutputBranchManager::outputTo(TTree *tree, int32_t maxOutputLevel) {
-	for (std::list<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
-		if (it->outputLevel <= maxOutputLevel) it->branch->outputTo(tree, 0);
+	m_tree = tree;
+	m_maxOutputLevel = maxOutputLevel;
+	static Setting<bool> autoTune("froast.output.basket.autotune", false);
+	static Setting<int32_t> autoTuneEntries("froast.output.basket.autotune.entries", 1000);
+	static Setting<int32_t> autoCompressEntries("froast.output.compression.auto.entries", 1000);
+
+	m_autoTune = autoTune;
+	m_autoTuneEntries = autoTuneEntries;
+	m_tuned = false;
+	m_autoCompress.clear();
+	m_autoCompressEntries = autoCompressEntries;
+	m_autoCompressNext = m_autoCompressEntries;
+
+	m_values.layout();
+	for (std::vector<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it) {
+		if (it->outputLevel > maxOutputLevel) continue;
+		it->branch->outputTo(tree, 0);
+
+		const char *branchName = it->branch->name().Data();
+		TBranch *branch = tree->GetBranch(branchName);
+		if (branch == 0) continue;
+		BranchOutputParams params = it->branch->outputParams().resolved(branchName);
+		if ((params.compressionAlgorithm >= 0) || (params.compressionLevel >= 0)) continue;
+		TString profile = OutputCompression::profile(tree->GetName(), branchName);
+		if (profile.Length() == 0) continue;
+		branch->SetCompressionSettings(OutputCompression::profileSettings(profile));
+		if (profile == "auto") m_autoCompress.push_back(branch);
+	}
 }
 
 
 void OutputBranchManager::clearData() {
-	for (std::list<BranchSpec>::iterator it = m_branches.begin(); it != m_branches.end(); ++it)
-		it->branch->clear();
+	m_values.clear();
 }
 
 
-OutputBranchManager::OutputBranchManager() {}
+OutputBranchManager::OutputBranchManager()
+	: m_tree(0), m_maxOutputLevel(0), m_autoTune(false), m_autoTuneEntries(0), m_tuned(false),
+	  m_autoCompressEntries(0), m_autoCompressNext(0)
+{}
 
 
 OutputBranchManager::~OutputBranchManager() {}
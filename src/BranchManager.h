@@ -19,9 +19,9 @@
 #define FROAST_BRANCHMANAGER_H
 
 #include <vector>
-#include <list>
 #include <string>
 #include <stdexcept>
+#include <new>
 #include <stdint.h>
 
 #include <Rtypes.h>
@@ -35,14 +35,70 @@ namespace froast {
 
 class BranchManager;
 class InputBranchManager;
+class EntryPipeline;
 class OutputBranchManager;
 
 
 
+///	@brief	Output parameters of a branch
+///
+///	Negative values mean "not specified". Unspecified parameters are
+///	resolved from the settings "froast.output.branch.BRANCH.PARAM" and
+///	"froast.output.PARAM", PARAM being one of "basket.size",
+///	"split.level", "compression.algorithm" and "compression.level".
+///	Unspecified compression parameters default to those of the output file.
+struct BranchOutputParams {
+	int32_t basketSize;
+	int32_t splitLevel;
+	int32_t compressionAlgorithm;
+	int32_t compressionLevel;
+
+	///	@brief	Resolve unspecified parameters from the global settings
+	BranchOutputParams resolved(const char* branchName) const;
+
+	///	@brief	Apply compression parameters (if specified) to a branch
+	void applyCompression(TBranch *branch) const;
+
+	BranchOutputParams(int32_t basket = -1, int32_t split = -1, int32_t algorithm = -1, int32_t level = -1)
+		: basketSize(basket), splitLevel(split), compressionAlgorithm(algorithm), compressionLevel(level) {}
+};
+
+
+
 class ManagedBranch {
+public:
+	///	@brief	Kind of value storage of a branch
+	///
+	///	Used by the branch managers to clear the values of all their
+	///	branches in bulk, instead of calling clear() on each of them.
+	enum ValueKind {
+		VK_GENERIC = 0, ///< Value has to be cleared via clear()
+		VK_SCALAR  = 1, ///< Plain scalar, cleared by zeroing its bytes, may be relocated
+		VK_VECTOR  = 2, ///< Vector, cleared via clearFunction()
+		VK_FIXED   = 3  ///< clear() has no effect
+	};
+
+	typedef void (*ClearFunction)(void *value);
+
 protected:
 	std::vector<TString> m_names;
 	bool m_inAvail;
+	bool m_addrInUse;
+	BranchOutputParams m_outParams;
+
+	TString m_inBranchName;
+	TBranch *m_inBranch;
+	const Long64_t *m_lazyEntry;
+	mutable Long64_t m_loadedEntry;
+	mutable Long64_t m_nLazyLoads;
+
+	void loadEntry() const;
+
+	///	@brief	Read the branch for the current entry, if in lazy mode and not done yet
+	void load() const { if ((m_lazyEntry != 0) && (m_loadedEntry != *m_lazyEntry)) loadEntry(); }
+
+	///	@brief	Mark the value as loaded, for operations that replace it completely
+	void overwrite() const { if (m_lazyEntry != 0) m_loadedEntry = *m_lazyEntry; }
 
 	template <typename Value> ManagedBranch& inputValueFrom(Value &value, TTree *tree, const char* branchName = 0, bool optional = false);
 
@@ -55,8 +111,30 @@ public:
 	
 	bool inputAvailable() const { return m_inAvail; }
 
+	///	@brief	Input TBranch (of the current tree), if any
+	TBranch* inputBranch() const { return m_inBranch; }
+
+	///	@brief	Re-resolve the input TBranch after a tree change (e.g. in a TChain)
+	void updateInputBranch(TTree *tree);
+
+	///	@brief	Enable or disable lazy input
+	///	@param	entry	Location of the current (local) entry number, 0 to disable
+	///
+	///	In lazy mode, the value is read from the input branch (via
+	///	TBranch::GetEntry) on first access within each entry only.
+	void lazyInput(const Long64_t *entry);
+
+	bool lazyInput() const { return m_lazyEntry != 0; }
+
+	///	@brief	Number of entries read on access (in lazy mode)
+	Long64_t lazyLoads() const { return m_nLazyLoads; }
+
 	ManagedBranch& addName(const TString &branchName);
 
+	const BranchOutputParams& outputParams() const { return m_outParams; }
+
+	ManagedBranch& outputParams(const BranchOutputParams &params);
+
 	virtual ManagedBranch& inputFrom(TTree *tree, const char* branchName = 0, bool optional = false) = 0;
 
 	virtual ManagedBranch& outputTo(TTree *tree, const char* branchName = 0) = 0;
@@ -66,9 +144,52 @@ public:
 	ManagedBranch& inputFrom(InputBranchManager &manager, bool optional = false);
 
 	ManagedBranch& outputTo(OutputBranchManager &manager, int32_t outputLevel = 0);
+
+	ManagedBranch& outputTo(OutputBranchManager &manager, int32_t outputLevel, const BranchOutputParams &params);
 	
 	virtual void clear() = 0;
 
+	virtual ValueKind valueKind() const { return VK_GENERIC; }
+
+	///	@brief	Size of the value in bytes (VK_SCALAR only)
+	virtual size_t valueSize() const { return 0; }
+
+	///	@brief	Current address of the value (VK_SCALAR and VK_VECTOR only)
+	virtual void* valueAddress() { return 0; }
+
+	///	@brief	Function that clears the value at valueAddress() (VK_VECTOR only)
+	virtual ClearFunction clearFunction() const { return 0; }
+
+	///	@brief	Move the value to storage provided by a branch manager
+	///	@param	storage	Suitably aligned memory of at least valueSize() bytes
+	///	@return	@c false if the value can't be moved (e.g. because its
+	///		address has already been passed to a TTree)
+	virtual bool relocateValue(void *storage) { return false; }
+
+	///	@brief	Name of the input TBranch the value is read from
+	const TString& inputBranchName() const { return m_inBranchName; }
+
+	///	@brief	Allocate a separate value of the branch's type
+	///
+	///	Separate values hold snapshots of the branch value, e.g. for
+	///	entries read ahead by an EntryPipeline. Returns 0 if snapshots are
+	///	not supported by the branch type.
+	virtual void* newValue() const { return 0; }
+
+	///	@brief	Delete a value allocated by newValue()
+	virtual void deleteValue(void *value) const { }
+
+	///	@brief	Assign a value (allocated by newValue(), or currentValue()) to another
+	virtual void copyValue(void *to, const void *from) const { }
+
+	///	@brief	Address of the current value, as accepted by copyValue()
+	virtual void* currentValue() { return 0; }
+
+	///	@brief	Bind an input branch to a value allocated by newValue()
+	///	@param	holder	Location of the value address, has to stay valid while the tree is in use
+	///	@return	Result of TTree::SetBranchAddress
+	virtual Int_t bindValue(TTree *tree, const char *branchName, void **holder) const { return -1; }
+
 	ManagedBranch();
 
 	ManagedBranch(const TString &branchName);
@@ -78,19 +199,28 @@ public:
 
 
 template <typename Value> ManagedBranch& ManagedBranch::inputValueFrom(Value &value, TTree *tree, const char* branchName, bool optional) {
-	if ((branchName != 0) && (tree->SetBranchAddress(branchName, &value) >= 0) ) { m_inAvail = true; return *this; }
+	m_addrInUse = true;
+	if ((branchName != 0) && (tree->SetBranchAddress(branchName, &value) >= 0) ) {
+		m_inBranchName = branchName;
+		m_inBranch = tree->GetBranch(branchName);
+		m_inAvail = true;
+		return *this;
+	}
 	else for (std::vector<TString>::const_iterator it = names().begin(); it != names().end(); ++it) {
 		// TChain::SetBranchAddress seems to return kNoCheck in every case, so:
 		if (tree->GetBranch(it->Data())) {
 			tree->SetBranchStatus(it->Data(), true);
 			if (tree->SetBranchAddress(it->Data(), &value) >= 0) {
 				tree->AddBranchToCache(it->Data());
+				m_inBranchName = *it;
+				m_inBranch = tree->GetBranch(it->Data());
 				m_inAvail = true;
 				return *this;
 			}
 		}
 	}
 	m_inAvail = false;
+	m_inBranch = 0;
 	if (!optional) throw std::runtime_error(Form("Could not load branch \"%s\"", branchName ? branchName : name().Data()));
 	return *this;
 }
@@ -98,7 +228,10 @@ template <typename Value> ManagedBranch& ManagedBranch::inputValueFrom(Value &va
 
 template<typename Value> ManagedBranch& ManagedBranch::outputValueTo(Value &value, TTree *tree, const char* branchName) {
 	if (branchName == 0) branchName = name().Data();
-	tree->Branch(branchName, &value, 32000, 0);
+	m_addrInUse = true;
+	BranchOutputParams params = m_outParams.resolved(branchName);
+	TBranch *branch = tree->Branch(branchName, &value, params.basketSize, params.splitLevel);
+	if (branch != 0) params.applyCompression(branch);
 	return *this;
 }
 
@@ -106,32 +239,58 @@ template<typename Value> ManagedBranch& ManagedBranch::outputValueTo(Value &valu
 
 template<typename A> class ScalarBranch: public ManagedBranch {
 protected:
-	A value;
+	A *value;
+	A m_localValue;
 	
 public:
 	virtual ManagedBranch& inputFrom(TTree *tree, const char* branchName = 0, bool optional = false)
-		{ return inputValueFrom(value, tree, branchName, optional); }
+		{ return inputValueFrom(*value, tree, branchName, optional); }
 
 	virtual ManagedBranch& outputTo(TTree *tree, const char* branchName = 0)
-		{ return outputValueTo(value, tree, branchName); }
+		{ return outputValueTo(*value, tree, branchName); }
 	
-	A& content() { return value; }
-	const A& content() const { return value; }
+	A& content() { load(); return *value; }
+	const A& content() const { load(); return *value; }
 
-	A& operator()() { return value; }
-	const A& operator()() const { return value; }
+	A& operator()() { load(); return *value; }
+	const A& operator()() const { load(); return *value; }
 
-	A& operator=(const A &x) { return value = x; }
+	A& operator=(const A &x) { overwrite(); return *value = x; }
 	
-	operator A& () { return value; }
-	operator const A& () const { return value; }
+	operator A& () { load(); return *value; }
+	operator const A& () const { load(); return *value; }
+
+	virtual void clear() { overwrite(); *value = 0; }
+
+	virtual ValueKind valueKind() const { return VK_SCALAR; }
+	virtual size_t valueSize() const { return sizeof(A); }
+	virtual void* valueAddress() { return value; }
+
+	virtual bool relocateValue(void *storage) {
+		if (m_addrInUse || (value != &m_localValue)) return false;
+		value = new(storage) A(m_localValue);
+		return true;
+	}
+
+	virtual void* newValue() const { return new A(0); }
+	virtual void deleteValue(void *v) const { delete static_cast<A*>(v); }
+	virtual void copyValue(void *to, const void *from) const { *static_cast<A*>(to) = *static_cast<const A*>(from); }
+	virtual void* currentValue() { load(); return value; }
+
+	virtual Int_t bindValue(TTree *tree, const char *branchName, void **holder) const
+		{ return tree->SetBranchAddress(branchName, static_cast<A*>(*holder)); }
 
-	virtual void clear() { value = 0; }
+	ScalarBranch& operator=(const ScalarBranch &other)
+		{ operator=(other.content()); return *this; }
 
-	ScalarBranch() {}
+	ScalarBranch()
+		: value(&m_localValue), m_localValue(0) {}
 
 	ScalarBranch(const TString &branchName)
-		: ManagedBranch(branchName) { }
+		: ManagedBranch(branchName), value(&m_localValue), m_localValue(0) { }
+
+	ScalarBranch(const ScalarBranch &other)
+		: ManagedBranch(other), value(&m_localValue), m_localValue(other.content()) { }
 	
 	virtual ~ScalarBranch() { }
 };
@@ -148,19 +307,29 @@ public:
 	virtual ManagedBranch& outputTo(TTree *tree, const char* branchName = 0)
 		{ return outputValueTo(value, tree, branchName); }
 
-	A& content() { return *value; }
-	const A& content() const { return *value; }
+	A& content() { load(); return *value; }
+	const A& content() const { load(); return *value; }
 
-	A& operator()() { return *value; }
-	const A& operator()() const { return *value; }
+	A& operator()() { load(); return *value; }
+	const A& operator()() const { load(); return *value; }
 	
-	A& operator=(const A &v) { return (*value) = v; }
+	A& operator=(const A &v) { overwrite(); return (*value) = v; }
 	
-	operator A& () { return *value; }
-	operator const A& () const { return *value; }
+	operator A& () { load(); return *value; }
+	operator const A& () const { load(); return *value; }
 
 	virtual void clear() { }
 
+	virtual ValueKind valueKind() const { return VK_FIXED; }
+
+	virtual void* newValue() const { return new A; }
+	virtual void deleteValue(void *v) const { delete static_cast<A*>(v); }
+	virtual void copyValue(void *to, const void *from) const { *static_cast<A*>(to) = *static_cast<const A*>(from); }
+	virtual void* currentValue() { load(); return value; }
+
+	virtual Int_t bindValue(TTree *tree, const char *branchName, void **holder) const
+		{ return tree->SetBranchAddress(branchName, reinterpret_cast<A**>(holder)); }
+
 	ObjectBranch() { value = new A; }
 
 	ObjectBranch(const TString &branchName)
@@ -184,35 +353,50 @@ public:
 	virtual ManagedBranch& outputTo(TTree *tree, const char* branchName = 0)
 		{ return outputValueTo(value, tree, branchName); }
 
-	std::vector<A>& content() { return *value; }
-	const std::vector<A>& content() const { return *value; }
+	std::vector<A>& content() { load(); return *value; }
+	const std::vector<A>& content() const { load(); return *value; }
 
-	std::vector<A>& operator()() { return *value; }
-	const std::vector<A>& operator()() const { return *value; }
+	std::vector<A>& operator()() { load(); return *value; }
+	const std::vector<A>& operator()() const { load(); return *value; }
 	
-	bool empty() { return value->empty(); }
-	size_t size() { return value->size(); }
-	size_t capacity() { return value->capacity(); }
-	void resize(size_t n) {  value->resize(n); }
-	void reserve(size_t n) {  value->reserve(n); }
-	void clear() { value->clear(); }
+	bool empty() { load(); return value->empty(); }
+	size_t size() { load(); return value->size(); }
+	size_t capacity() { load(); return value->capacity(); }
+	void resize(size_t n) { load(); value->resize(n); }
+	void reserve(size_t n) { load(); value->reserve(n); }
+	void clear() { overwrite(); value->clear(); }
+
+	virtual ValueKind valueKind() const { return VK_VECTOR; }
+	virtual void* valueAddress() { return value; }
+	virtual ClearFunction clearFunction() const { return &clearValue; }
+
+	static void clearValue(void *v) { static_cast< std::vector<A>* >(v)->clear(); }
+
+	virtual void* newValue() const { return new std::vector<A>; }
+	virtual void deleteValue(void *v) const { delete static_cast< std::vector<A>* >(v); }
+	virtual void copyValue(void *to, const void *from) const
+		{ *static_cast< std::vector<A>* >(to) = *static_cast< const std::vector<A>* >(from); }
+	virtual void* currentValue() { load(); return value; }
+
+	virtual Int_t bindValue(TTree *tree, const char *branchName, void **holder) const
+		{ return tree->SetBranchAddress(branchName, reinterpret_cast< std::vector<A>** >(holder)); }
 	
-	A& operator[](size_t i) { return value->at(i); }
-	const A& operator[](size_t i) const { return value->at(i); }
-	A& at(size_t i) { return value->at(i); }
-	const A& at(size_t i) const { return value->at(i); }
+	A& operator[](size_t i) { load(); return value->at(i); }
+	const A& operator[](size_t i) const { load(); return value->at(i); }
+	A& at(size_t i) { load(); return value->at(i); }
+	const A& at(size_t i) const { load(); return value->at(i); }
 	
-	std::vector<A>& operator=(const std::vector<A> &v) { return (*value) = v; }
+	std::vector<A>& operator=(const std::vector<A> &v) { overwrite(); return (*value) = v; }
 
-	void push_back(const A &x) { value->push_back(x); }
+	void push_back(const A &x) { load(); value->push_back(x); }
 
-	typename std::vector<A>::iterator begin() { return value->begin(); }
-	typename std::vector<A>::const_iterator begin() const { return value->begin(); }
-	typename std::vector<A>::iterator end() { return value->end(); }
-	typename std::vector<A>::const_iterator end() const { return value->end(); }
+	typename std::vector<A>::iterator begin() { load(); return value->begin(); }
+	typename std::vector<A>::const_iterator begin() const { load(); return value->begin(); }
+	typename std::vector<A>::iterator end() { load(); return value->end(); }
+	typename std::vector<A>::const_iterator end() const { load(); return value->end(); }
 	
-	operator std::vector<A>& () { return *value; }
-	operator const std::vector<A>& () const { return *value; }
+	operator std::vector<A>& () { load(); return *value; }
+	operator const std::vector<A>& () const { load(); return *value; }
 
 	VectorBranch()
 		{ value = new std::vector<A>; }
@@ -225,9 +409,67 @@ public:
 
 
 
+///	@brief	Contiguous value storage for the branches of a branch manager
+///
+///	Scalar branch values are relocated into a single aligned arena when the
+///	store is laid out, so clearing all values amounts to one memset of the
+///	arena plus a tight loop over the vector values. Scalars that can't be
+///	relocated any more (e.g. because they belong to another store already)
+///	are zeroed in place, branches added after layout and branches of other
+///	kinds are cleared via ManagedBranch::clear().
+///
+///	Relocated branches must not be used after the store has been destroyed.
+class BranchValueStore {
+protected:
+	struct ScalarRef {
+		void *value;
+		size_t size;
+		ScalarRef(void *v, size_t s) : value(v), size(s) {}
+	};
+
+	struct VectorRef {
+		void *value;
+		ManagedBranch::ClearFunction clear;
+		VectorRef(void *v, ManagedBranch::ClearFunction f) : value(v), clear(f) {}
+	};
+
+	std::vector<ManagedBranch*> m_pending;
+	std::vector<ScalarRef> m_inPlace;
+	std::vector<VectorRef> m_vectors;
+	std::vector<ManagedBranch*> m_generic;
+
+	char *m_arena;
+	size_t m_arenaSize;
+	bool m_laidOut;
+
+	BranchValueStore(const BranchValueStore &);
+	BranchValueStore& operator=(const BranchValueStore &);
+
+public:
+	void add(ManagedBranch &branch);
+
+	///	@brief	Relocate pending scalar values into the arena
+	///
+	///	Has to be called before the branch value addresses are passed to a
+	///	TTree, called automatically by clear() if necessary.
+	void layout();
+
+	bool laidOut() const { return m_laidOut; }
+
+	size_t arenaSize() const { return m_arenaSize; }
+
+	void clear();
+
+	BranchValueStore();
+	virtual ~BranchValueStore();
+};
+
+
+
 class BranchManager {
 protected:
-	std::list<ManagedBranch*> m_branches;
+	std::vector<ManagedBranch*> m_branches;
+	BranchValueStore m_values;
 
 public:
 	void add(ManagedBranch &branch);
@@ -257,14 +499,61 @@ protected:
 			: branch(managedBranch), optional(isOptional) {}
 	};
 
-	std::list<BranchSpec> m_branches;
+	std::vector<BranchSpec> m_branches;
+	BranchValueStore m_values;
+
+	TTree *m_tree;
+	bool m_lazy;
+	Long64_t m_entry;
+	Long64_t m_learnEntries;
+	Long64_t m_nEntries;
+	bool m_learned;
+	EntryPipeline *m_pipeline;
+
+	void learn();
+	void applyLearned();
 
 public:
 
 	void add(ManagedBranch &branch, bool optional = false);
 
+	///	@brief	Set up the branches for input from a tree
+	///
+	///	If "froast.input.lazy" is set, branches are read on first access
+	///	within an entry instead of by TTree::GetEntry (see setEntry()).
+	///	The branches actually accessed during the first
+	///	"froast.input.lazy.learn.entries" entries are then added to the
+	///	TTreeCache, and its learning phase is stopped.
+	///
+	///	Otherwise, if "froast.input.pipeline" is set (default: false),
+	///	entries are read ahead in a separate thread by an EntryPipeline and
+	///	have to be loaded via fetchEntry() instead of TTree::GetEntry.
 	void inputFrom(TTree *tree);
 
+	bool lazy() const { return m_lazy; }
+
+	bool pipelined() const { return m_pipeline != 0; }
+
+	///	@brief	Get the managed input branches
+	///	@param	availableOnly	Skip branches not available in the input tree
+	void inputBranches(std::vector<ManagedBranch*> &branches, bool availableOnly = true) const;
+
+	///	@brief	Load an entry read ahead by the input pipeline
+	///	@param	entry	Entry number (global, for a TChain)
+	void fetchEntry(Long64_t entry);
+
+	///	@brief	Stop reading ahead (if pipelined)
+	void finish();
+
+	///	@brief	Set the current (local) entry number in lazy mode
+	void setEntry(Long64_t entry) {
+		m_entry = entry;
+		if (!m_learned) learn();
+	}
+
+	///	@brief	Update input branches after a tree change (e.g. in a TChain)
+	void notify();
+
 	void clearData();
 
 	InputBranchManager();
@@ -284,14 +573,54 @@ protected:
 			: branch(managedBranch), outputLevel(branchOutputLevel) {}
 	};
 
-	std::list<BranchSpec> m_branches;
+	std::vector<BranchSpec> m_branches;
+	BranchValueStore m_values;
+
+	TTree *m_tree;
+	int32_t m_maxOutputLevel;
+	bool m_autoTune;
+	Long64_t m_autoTuneEntries;
+	bool m_tuned;
+
+	std::vector<TBranch*> m_autoCompress;
+	Long64_t m_autoCompressEntries;
+	Long64_t m_autoCompressNext;
+
+	void tuneBaskets();
+	void tuneCompression();
 
 public:
 
 	void add(ManagedBranch &branch, int32_t outputLevel = 0);
 
+	void add(ManagedBranch &branch, int32_t outputLevel, const BranchOutputParams &params);
+
+	///	@brief	Create the output branches in a tree
+	///
+	///	If "froast.output.basket.autotune" is set, basket sizes are
+	///	re-calculated by autoTune() once "froast.output.basket.autotune.entries"
+	///	entries have been filled, so that a cluster of
+	///	"froast.output.cluster.size" MB (uncompressed) fills one basket
+	///	per branch. The AutoFlush of the tree is set accordingly, unless
+	///	the output cluster policy (see OutputClusters) is "entries" or
+	///	"input".
+	///
+	///	Compression profiles (see OutputCompression) are applied to branches
+	///	without explicit compression parameters.
 	void outputTo(TTree *tree, int32_t maxOutputLevel = 0);
 
+	///	@brief	Tune basket sizes and "auto" profile compression, if enabled
+	///	and enough entries are available
+	///
+	///	Cheap enough to be called after every TTree::Fill().
+	void autoTune() {
+		if (m_tree == 0) return;
+		if (m_autoTune && !m_tuned && (m_tree->GetEntriesFast() >= m_autoTuneEntries))
+			tuneBaskets();
+		if (!m_autoCompress.empty() && (m_tree->GetEntriesFast() >= m_autoCompressNext))
+			tuneCompression();
+	}
+
 	void clearData();
 
 	OutputBranchManager();
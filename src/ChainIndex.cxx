@@ -0,0 +1,301 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "ChainIndex.h"
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include <RVersion.h>
+#include <TROOT.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TChainElement.h>
+
+#include "logging.h"
+#include "util.h"
+#include "File.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+struct ScanQueue {
+	std::vector<ChainIndex::Entry*> *entries;
+	size_t next;
+	pthread_mutex_t mutex;
+};
+
+bool fileStat(const TString &fileName, Long64_t &size, Long64_t &mtime) {
+	struct stat st;
+	if (stat(fileName.Data(), &st) != 0) return false;
+	size = st.st_size;
+	mtime = st.st_mtime;
+	return true;
+}
+
+} // namespace
+
+
+ULong64_t ChainIndex::checksum(const TString &fileName, Long64_t size) {
+	// FNV-1a over size, file head (TFile header with fEND, fSeekInfo and
+	// UUID) and tail (keys list)
+	const size_t chunk = 4096;
+	ULong64_t hash = 14695981039346656037ULL;
+	for (int i = 0; i < 8; ++i) { hash ^= (ULong64_t(size) >> (8*i)) & 0xff; hash *= 1099511628211ULL; }
+
+	int fd = ::open(fileName.Data(), O_RDONLY);
+	if (fd < 0) return 0;
+	std::vector<unsigned char> buffer(chunk);
+	Long64_t offsets[2] = { 0, std::max(Long64_t(0), size - Long64_t(chunk)) };
+	for (int part = 0; part < 2; ++part) {
+		ssize_t n = pread(fd, &buffer[0], chunk, offsets[part]);
+		for (ssize_t i = 0; i < n; ++i) { hash ^= buffer[i]; hash *= 1099511628211ULL; }
+	}
+	::close(fd);
+	return hash;
+}
+
+
+bool ChainIndex::scan(Entry &entry) {
+	if (!fileStat(entry.fileName, entry.size, entry.mtime)) return false;
+	entry.checksum = checksum(entry.fileName, entry.size);
+
+	auto_ptr<TFile> file(TFile::Open(entry.fileName, "read"));
+	if ((file.get() == 0) || file->IsZombie()) return false;
+	TTree *tree = 0;
+	file->GetObject(entry.treeName, tree);
+	if (tree == 0) return false;
+
+	entry.entries = tree->GetEntries();
+	entry.clusters.clear();
+	TTree::TClusterIterator clusters = tree->GetClusterIterator(0);
+	for (Long64_t start = clusters.Next(); start < entry.entries; start = clusters.Next())
+		entry.clusters.push_back(start);
+	return true;
+}
+
+
+void* ChainIndex::scanThreadMain(void *arg) {
+	ScanQueue &queue = *static_cast<ScanQueue*>(arg);
+	while (true) {
+		pthread_mutex_lock(&queue.mutex);
+		size_t i = queue.next++;
+		pthread_mutex_unlock(&queue.mutex);
+		if (i >= queue.entries->size()) break;
+		Entry &entry = *(*queue.entries)[i];
+		if (!scan(entry)) entry.entries = -1;
+	}
+	return 0;
+}
+
+
+void ChainIndex::scan(std::vector<Entry*> &entries) {
+	if (entries.empty()) return;
+	log_info("Indexing %lli input files", (long long)entries.size());
+
+	size_t nThreads = 1;
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	nThreads = std::min(entries.size(), size_t(std::max(1, int(GSettings::get("froast.input.index.threads", 4)))));
+	if (nThreads > 1) ROOT::EnableThreadSafety();
+	#endif
+
+	ScanQueue queue;
+	queue.entries = &entries;
+	queue.next = 0;
+	pthread_mutex_init(&queue.mutex, 0);
+
+	std::vector<pthread_t> threads;
+	for (size_t i = 1; i < nThreads; ++i) {
+		pthread_t thread;
+		if (pthread_create(&thread, 0, scanThreadMain, &queue) == 0) threads.push_back(thread);
+	}
+	scanThreadMain(&queue);
+	for (size_t i = 0; i < threads.size(); ++i) pthread_join(threads[i], 0);
+
+	pthread_mutex_destroy(&queue.mutex);
+}
+
+
+void ChainIndex::apply(TChain *chain) {
+	if (!GSettings::get("froast.input.index", true)) return;
+
+	TObjArray *chainElems = chain->GetListOfFiles();
+	const Int_t nElems = chainElems->GetEntriesFast();
+	if (nElems == 0) return;
+
+	std::vector<TString> fileNames(nElems), treeNames(nElems);
+	std::vector<Long64_t> entries(nElems, -1);
+	for (Int_t i = 0; i < nElems; ++i) {
+		TChainElement *e = dynamic_cast<TChainElement*>(chainElems->At(i));
+		fileNames[i] = e->GetTitle();
+		treeNames[i] = e->GetName();
+	}
+
+	typedef std::map<TString, ChainIndex*> Indices;
+	Indices indices;
+	std::vector<Entry> missing;
+	std::vector<Int_t> missingElem;
+	for (Int_t i = 0; i < nElems; ++i) {
+		// Only plain local files are indexed:
+		if (fileNames[i].Index(":") >= 0) continue;
+		TString dirName = File(fileNames[i].Data()).dirname();
+		ChainIndex *&index = indices[dirName];
+		if (index == 0) index = new ChainIndex(dirName);
+		const Entry *entry = index->find(fileNames[i], treeNames[i]);
+		if (entry != 0) {
+			entries[i] = entry->entries;
+		} else {
+			missing.push_back(Entry());
+			missing.back().fileName = fileNames[i];
+			missing.back().treeName = treeNames[i];
+			missingElem.push_back(i);
+		}
+	}
+
+	std::vector<Entry*> toScan(missing.size());
+	for (size_t j = 0; j < missing.size(); ++j) toScan[j] = &missing[j];
+	scan(toScan);
+	for (size_t j = 0; j < missing.size(); ++j) if (missing[j].entries >= 0) {
+		entries[missingElem[j]] = missing[j].entries;
+		indices[File(missing[j].fileName.Data()).dirname()]->update(missing[j]);
+	}
+
+	for (Indices::iterator it = indices.begin(); it != indices.end(); ++it) {
+		it->second->write();
+		delete it->second;
+	}
+
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,8,0)
+	const Long64_t unknownEntries = TTree::kMaxEntries;
+	#else
+	const Long64_t unknownEntries = TChain::kBigNumber;
+	#endif
+
+	chain->Reset();
+	for (Int_t i = 0; i < nElems; ++i) {
+		// Files with zero or unknown entries are left to TChain, as before
+		chain->AddFile(fileNames[i], (entries[i] > 0) ? entries[i] : unknownEntries, treeNames[i]);
+	}
+}
+
+
+TString ChainIndex::indexPath() const {
+	return (File(m_dirName.Data()) / GSettings::get("froast.input.index.name", ".froast-index")).path();
+}
+
+
+const ChainIndex::Entry* ChainIndex::find(const TString &fileName, const TString &treeName) {
+	Entries::iterator it = m_entries.find(key(File(fileName.Data()).basename(), treeName));
+	if (it == m_entries.end()) return 0;
+	Entry &entry = it->second;
+
+	Long64_t size = -1, mtime = -1;
+	if (!fileStat(fileName, size, mtime)) return 0;
+	if (size != entry.size) return 0;
+	if (mtime != entry.mtime) {
+		// File touched or copied, check whether contents changed:
+		if (checksum(fileName, size) != entry.checksum) return 0;
+		entry.mtime = mtime;
+		m_modified = true;
+	}
+	return &entry;
+}
+
+
+void ChainIndex::update(const Entry &entry) {
+	Entry &stored = m_entries[key(File(entry.fileName.Data()).basename(), entry.treeName)];
+	stored = entry;
+	stored.fileName = File(entry.fileName.Data()).basename();
+	m_modified = true;
+}
+
+
+void ChainIndex::read() {
+	ifstream in(indexPath().Data());
+	if (!in) return;
+	string line;
+	while (getline(in, line)) {
+		if (line.empty() || (line[0] == '#')) continue;
+		std::vector<TString> fields;
+		Util::split(line.c_str(), "\t", fields);
+		if (fields.size() < 6) continue;
+		Entry entry;
+		entry.fileName = fields[0];
+		entry.treeName = fields[1];
+		entry.size = atoll(fields[2].Data());
+		entry.mtime = atoll(fields[3].Data());
+		entry.checksum = strtoull(fields[4].Data(), 0, 16);
+		entry.entries = atoll(fields[5].Data());
+		if (fields.size() > 6) {
+			std::vector<TString> clusters;
+			Util::split(fields[6], ",", clusters);
+			for (size_t i = 0; i < clusters.size(); ++i) entry.clusters.push_back(atoll(clusters[i].Data()));
+		}
+		m_entries[key(entry.fileName, entry.treeName)] = entry;
+	}
+}
+
+
+void ChainIndex::write() {
+	if (!m_modified) return;
+	TString path = indexPath();
+	TString tmpPath = TString::Format("%s.%li.tmp", path.Data(), long(getpid()));
+	{
+		ofstream out(tmpPath.Data());
+		if (!out) { log_debug("Can't write chain index \"%s\"", path.Data()); return; }
+		out << "# FILE\tTREE\tSIZE\tMTIME\tCHECKSUM\tENTRIES\tCLUSTERS" << endl;
+		for (Entries::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+			const Entry &e = it->second;
+			out << e.fileName << "\t" << e.treeName << "\t" << e.size << "\t" << e.mtime << "\t"
+				<< std::hex << e.checksum << std::dec << "\t" << e.entries << "\t";
+			for (size_t i = 0; i < e.clusters.size(); ++i) out << (i > 0 ? "," : "") << e.clusters[i];
+			out << "\n";
+		}
+		if (!out) { log_debug("Can't write chain index \"%s\"", path.Data()); remove(tmpPath.Data()); return; }
+	}
+	if (rename(tmpPath.Data(), path.Data()) != 0) remove(tmpPath.Data());
+	else m_modified = false;
+}
+
+
+ChainIndex::ChainIndex(const TString &dirName)
+	: m_dirName(dirName), m_modified(false)
+{
+	read();
+}
+
+
+ChainIndex::~ChainIndex() {}
+
+
+} // namespace froast
@@ -0,0 +1,112 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_CHAININDEX_H
+#define FROAST_CHAININDEX_H
+
+#include <map>
+#include <vector>
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TChain.h>
+
+
+namespace froast {
+
+
+///	@brief	Persistent per-directory index of TTree entry counts
+///
+///	Stores, for each file and tree, the file size, modification time and a
+///	checksum of the file head and tail, the number of entries and the
+///	cluster boundaries, in a sidecar file in the directory of the input
+///	files. With it, chains can be set up without opening every file.
+///
+///	Sidecar format: One line per file and tree, tab-separated:
+///	FILE_NAME TREE_NAME SIZE MTIME CHECKSUM ENTRIES CLUSTER_STARTS
+///	(CLUSTER_STARTS comma-separated).
+///
+///	Settings:
+///	- "froast.input.index": Use the index (default: true)
+///	- "froast.input.index.name": Name of the sidecar file (default: ".froast-index")
+///	- "froast.input.index.threads": Number of threads to index changed
+///	  files with (ROOT 6 and above only, default: 4)
+
+class ChainIndex {
+public:
+	struct Entry {
+		TString fileName;
+		TString treeName;
+		Long64_t size;
+		Long64_t mtime;
+		ULong64_t checksum;
+		Long64_t entries;
+		std::vector<Long64_t> clusters;
+
+		Entry(): size(-1), mtime(-1), checksum(0), entries(-1) {}
+	};
+
+protected:
+	typedef std::map<TString, Entry> Entries;
+
+	TString m_dirName;
+	Entries m_entries;
+	bool m_modified;
+
+	static TString key(const TString &baseName, const TString &treeName) { return baseName + "\t" + treeName; }
+
+	static void* scanThreadMain(void *arg);
+
+public:
+	///	@brief	Checksum of a file's head and tail
+	static ULong64_t checksum(const TString &fileName, Long64_t size);
+
+	///	@brief	Open a file and fill in entries and cluster boundaries
+	///	@return	@c false if the file or tree couldn't be read
+	static bool scan(Entry &entry);
+
+	///	@brief	Scan several files, in parallel if possible
+	static void scan(std::vector<Entry*> &entries);
+
+	///	@brief	Set up entry numbers of a chain from the index
+	///
+	///	Rebuilds the chain file list, giving each file its entry count, so
+	///	that TChain won't have to open it. Stale or missing index entries
+	///	are refreshed and written back.
+	static void apply(TChain *chain);
+
+	TString indexPath() const;
+
+	///	@brief	Look up an up-to-date entry, refreshing the checksum-matched ones
+	///	@return	Entry, or 0 if missing or stale
+	const Entry* find(const TString &fileName, const TString &treeName);
+
+	void update(const Entry &entry);
+
+	void read();
+	void write();
+
+	ChainIndex(const TString &dirName);
+	virtual ~ChainIndex();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_CHAININDEX_H
@@ -0,0 +1,288 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "EntryPipeline.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <sched.h>
+#include <time.h>
+
+#include <RVersion.h>
+#include <TROOT.h>
+#include <TChain.h>
+#include <TChainElement.h>
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TList.h>
+#include <TTreeCacheUnzip.h>
+
+#include "InputCache.h"
+#include "logging.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+// Values of the input stage's own tree, deleted after the tree is gone
+struct ReadValues {
+	const vector<ManagedBranch*> &branches;
+	vector<void*> values;
+
+	ReadValues(const vector<ManagedBranch*> &b) : branches(b), values(b.size(), (void*)0) {
+		for (size_t i = 0; i < branches.size(); ++i) values[i] = branches[i]->newValue();
+	}
+
+	~ReadValues() {
+		for (size_t i = 0; i < branches.size(); ++i) branches[i]->deleteValue(values[i]);
+	}
+};
+
+} // namespace
+
+
+void EntryPipeline::backoff(int &n) {
+	++n;
+	if (n < 64) return;
+	else if (n < 128) sched_yield();
+	else {
+		struct timespec t = { 0, 50000 };
+		nanosleep(&t, 0);
+	}
+}
+
+
+void* EntryPipeline::threadMain(void *arg) {
+	static_cast<EntryPipeline*>(arg)->run();
+	return 0;
+}
+
+
+void EntryPipeline::run() {
+	try { read(); }
+	catch (std::exception &e) { m_error = e.what(); }
+	catch (...) { m_error = "Unknown exception in input pipeline"; }
+
+	Slot *slot = 0;
+	if (!nextFreeSlot(slot)) return;
+	slot->entry = m_error.empty() ? END_OF_INPUT : INPUT_FAILED;
+	m_ready.try_push(slot);
+}
+
+
+bool EntryPipeline::nextFreeSlot(Slot* &slot) {
+	int n = 0;
+	while (!m_free.try_pop(slot)) {
+		if (stopRequested()) return false;
+		if (n == 0) ++m_inputStalls;
+		backoff(n);
+	}
+	return true;
+}
+
+
+void EntryPipeline::read() {
+	ReadValues current(m_branches);
+
+	TDirectory::TContext context(gROOT);
+	TChain chain(m_treeNames.front().Data());
+	for (size_t i = 0; i < m_fileNames.size(); ++i)
+		chain.AddFile(m_fileNames[i].Data(), m_fileEntries[i], m_treeNames[i].Data());
+
+	if (m_unzip) TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+	InputCache::prepare(&chain, m_cacheConfig);
+	chain.SetBranchStatus("*", false);
+	for (size_t i = 0; i < m_branches.size(); ++i) {
+		const char *name = m_branches[i]->inputBranchName().Data();
+		chain.SetBranchStatus(name, true);
+		if (m_branches[i]->bindValue(&chain, name, &current.values[i]) < 0)
+			throw runtime_error(Form("Input pipeline could not load branch \"%s\"", name));
+		chain.AddBranchToCache(name);
+	}
+	InputCache::adapt(&chain, 1, m_cacheConfig);
+
+	for (Long64_t entry = m_first; !stopRequested(); ++entry) {
+		if (chain.LoadTree(entry) < 0) break;
+		Slot *slot = 0;
+		if (!nextFreeSlot(slot)) break;
+		chain.GetEntry(entry);
+		for (size_t i = 0; i < m_branches.size(); ++i)
+			m_branches[i]->copyValue(slot->values[i], current.values[i]);
+		slot->entry = entry;
+		// Can't fail, there are no more slots than the queue can hold:
+		m_ready.try_push(slot);
+	}
+
+	chain.ResetBranchAddresses();
+}
+
+
+void EntryPipeline::start(Long64_t firstEntry) {
+	m_first = firstEntry;
+	m_next = firstEntry;
+	m_error.clear();
+	__atomic_store_n(&m_stop, 0, __ATOMIC_RELEASE);
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	ROOT::EnableThreadSafety();
+	#endif
+	if (pthread_create(&m_thread, 0, threadMain, this) != 0)
+		throw runtime_error("Can't start input pipeline thread");
+	m_running = true;
+}
+
+
+void EntryPipeline::stop() {
+	if (!m_running) return;
+	__atomic_store_n(&m_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(m_thread, 0);
+	m_running = false;
+
+	// Return entries read ahead, but not fetched:
+	Slot *slot = 0;
+	while (m_ready.try_pop(slot)) m_free.try_push(slot);
+}
+
+
+bool EntryPipeline::supported(TTree *tree, const vector<ManagedBranch*> &branches) {
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	if ((tree->GetListOfFriends() != 0) && (tree->GetListOfFriends()->GetSize() > 0)) {
+		log_warn("Input pipeline not supported for trees with friends");
+		return false;
+	}
+	if ((dynamic_cast<TChain*>(tree) == 0) && (tree->GetCurrentFile() == 0)) {
+		log_warn("Input pipeline not supported for in-memory trees");
+		return false;
+	}
+	for (vector<ManagedBranch*>::const_iterator it = branches.begin(); it != branches.end(); ++it) {
+		void *value = (*it)->newValue();
+		if (value == 0) {
+			log_warn("Input pipeline not supported for branch \"%s\"", (*it)->name().Data());
+			return false;
+		}
+		(*it)->deleteValue(value);
+	}
+	return true;
+	#else
+	log_warn("Input pipeline requires ROOT 6 or newer");
+	return false;
+	#endif
+}
+
+
+void EntryPipeline::fetch(Long64_t entry) {
+	// Small forward gaps (e.g. due to an entry list) are skipped, otherwise
+	// the input stage is restarted
+	bool inRange = m_running && (entry >= m_next) && (entry - m_next < Long64_t(m_slots.size()));
+	if (!inRange) {
+		if (m_running) log_debug("Input pipeline: Restarting at entry %lli (expected %lli)", (long long)entry, (long long)m_next);
+		stop();
+		start(entry);
+	}
+
+	Slot *slot = 0;
+	while (true) {
+		int n = 0;
+		while (!m_ready.try_pop(slot)) {
+			if (n == 0) ++m_processStalls;
+			backoff(n);
+		}
+		if ((slot->entry < 0) || (slot->entry >= entry)) break;
+		m_free.try_push(slot);
+	}
+
+	if (slot->entry < 0) {
+		bool failed = (slot->entry == INPUT_FAILED);
+		m_free.try_push(slot);
+		stop();
+		if (failed) throw runtime_error(m_error);
+		else throw runtime_error(Form("Input pipeline: No entry %lli in input", (long long)entry));
+	}
+
+	for (size_t i = 0; i < m_branches.size(); ++i)
+		m_branches[i]->copyValue(m_branches[i]->currentValue(), slot->values[i]);
+	m_free.try_push(slot);
+	m_next = entry + 1;
+	++m_nFetched;
+}
+
+
+void EntryPipeline::finish() {
+	stop();
+	if (m_nFetched > 0) {
+		log_info("Input pipeline: %lli entries, input stage waited %lli times for the processing stage, processing stage waited %lli times for input",
+			(long long)m_nFetched, (long long)m_inputStalls, (long long)m_processStalls);
+	}
+	m_nFetched = m_inputStalls = m_processStalls = 0;
+}
+
+
+EntryPipeline::EntryPipeline(TTree *tree, const vector<ManagedBranch*> &branches)
+	: m_branches(branches),
+	  m_slots(size_t(std::max(2, int(GSettings::get("froast.input.pipeline.depth", 256))))),
+	  m_free(m_slots.size()), m_ready(m_slots.size()),
+	  m_running(false), m_stop(0), m_first(0), m_next(0),
+	  m_nFetched(0), m_inputStalls(0), m_processStalls(0)
+{
+	m_unzip = GSettings::get("froast.input.pipeline.unzip", true);
+
+	TChain *chain = dynamic_cast<TChain*>(tree);
+	if (chain != 0) {
+		TIter next(chain->GetListOfFiles());
+		TChainElement *element = 0;
+		while ((element = dynamic_cast<TChainElement*>(next())) != 0) {
+			m_fileNames.push_back(element->GetTitle());
+			m_treeNames.push_back(element->GetName());
+			m_fileEntries.push_back(element->GetEntries());
+		}
+	} else {
+		// Name of the tree, relative to its file:
+		TString path = tree->GetDirectory()->GetPath();
+		Ssiz_t pos = path.Index(":/");
+		TString dir = (pos >= 0) ? TString(path(pos + 2, path.Length())) : TString();
+		m_fileNames.push_back(tree->GetCurrentFile()->GetName());
+		m_treeNames.push_back(dir.Length() > 0 ? dir + "/" + tree->GetName() : TString(tree->GetName()));
+		m_fileEntries.push_back(tree->GetEntries());
+	}
+	if (m_fileNames.empty()) throw invalid_argument("Input pipeline: No input files");
+
+	for (vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+		it->values.resize(m_branches.size());
+		for (size_t i = 0; i < m_branches.size(); ++i) it->values[i] = m_branches[i]->newValue();
+		m_free.try_push(&(*it));
+	}
+
+	log_debug("Input pipeline: Reading up to %li entries ahead", long(m_slots.size()));
+}
+
+
+EntryPipeline::~EntryPipeline() {
+	stop();
+	for (vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+		for (size_t i = 0; i < m_branches.size(); ++i) m_branches[i]->deleteValue(it->values[i]);
+	}
+}
+
+
+} // namespace froast
@@ -0,0 +1,132 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_ENTRYPIPELINE_H
+#define FROAST_ENTRYPIPELINE_H
+
+#include <vector>
+#include <string>
+
+#include <pthread.h>
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TTree.h>
+
+#include "BranchManager.h"
+#include "InputCache.h"
+#include "spsc_queue.h"
+
+
+namespace froast {
+
+
+///	@brief	Reads input entries ahead in a separate thread
+///
+///	The input stage of a pipelined TreeMapperSel: A helper thread opens its
+///	own copy of the input TTree/TChain, reads (and decompresses) entries
+///	in order and passes snapshots of the branch values to the processing
+///	thread via a bounded lock-free queue. fetch() copies the snapshot of
+///	an entry into the values of the managed branches.
+///
+///	Entries are always delivered in input order. If the queue is full, the
+///	input stage waits for the processing stage (back-pressure), so at most
+///	"froast.input.pipeline.depth" entries are held in memory. Entries
+///	skipped by the caller are dropped, requesting an earlier entry (or one
+///	beyond the read-ahead depth) restarts the input stage at that entry.
+///
+///	Requires ROOT 6 (start() enables ROOT's thread safety), input trees
+///	without friends and branch types supporting ManagedBranch::newValue().
+///
+///	Settings:
+///	- "froast.input.pipeline.depth": Number of entries to read ahead
+///	  (default: 256)
+///	- "froast.input.pipeline.unzip": Decompress baskets in parallel in the
+///	  input stage's TTreeCache (default: true)
+
+class EntryPipeline {
+protected:
+	struct Slot {
+		Long64_t entry;
+		std::vector<void*> values;
+		Slot() : entry(-1) {}
+	};
+
+	// Special Slot::entry values, to terminate the queue:
+	static const Long64_t END_OF_INPUT = -1;
+	static const Long64_t INPUT_FAILED = -2;
+
+	std::vector<ManagedBranch*> m_branches;
+	std::vector<TString> m_fileNames;
+	std::vector<TString> m_treeNames;
+	std::vector<Long64_t> m_fileEntries;
+	// Settings are read by the constructor, the input stage doesn't access them
+	bool m_unzip;
+	InputCache::Config m_cacheConfig;
+
+	std::vector<Slot> m_slots;
+	spsc_queue<Slot*> m_free;
+	spsc_queue<Slot*> m_ready;
+
+	pthread_t m_thread;
+	bool m_running;
+	int m_stop;
+	Long64_t m_first;
+	Long64_t m_next;
+	std::string m_error;
+
+	Long64_t m_nFetched;
+	Long64_t m_inputStalls;
+	Long64_t m_processStalls;
+
+	EntryPipeline(const EntryPipeline &);
+	EntryPipeline& operator=(const EntryPipeline &);
+
+	static void* threadMain(void *arg);
+	void run();
+	void read();
+	bool nextFreeSlot(Slot* &slot);
+	bool stopRequested() const { return __atomic_load_n(&m_stop, __ATOMIC_ACQUIRE) != 0; }
+
+	void start(Long64_t firstEntry);
+	void stop();
+
+	static void backoff(int &n);
+
+public:
+	///	@brief	Check if entries of a tree can be read ahead into the given branches
+	///
+	///	Logs the reason if not.
+	static bool supported(TTree *tree, const std::vector<ManagedBranch*> &branches);
+
+	///	@brief	Load an entry into the branch values
+	///	@param	entry	Entry number (global, for a TChain)
+	void fetch(Long64_t entry);
+
+	///	@brief	Stop reading ahead and log statistics
+	void finish();
+
+	EntryPipeline(TTree *tree, const std::vector<ManagedBranch*> &branches);
+	virtual ~EntryPipeline();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_ENTRYPIPELINE_H
@@ -0,0 +1,132 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "EventWindow.h"
+
+#include <stdexcept>
+
+#include "logging.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+void EventWindow::freeSlots() {
+	for (vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+		for (size_t i = 0; i < it->values.size(); ++i) m_branches[i]->deleteValue(it->values[i]);
+	}
+	m_slots.clear();
+}
+
+
+const void* EventWindow::value(const ManagedBranch &branch, Int_t offset) const {
+	map<const ManagedBranch*, size_t>::const_iterator found = m_index.find(&branch);
+	if (found == m_index.end()) throw invalid_argument(Form("Branch \"%s\" is not part of the event window", branch.name().Data()));
+	if (!available(offset)) throw out_of_range(Form("No entry at offset %i in event window", int(offset)));
+	return slot(offset).values[found->second];
+}
+
+
+void EventWindow::resize(Int_t previous, Int_t next) {
+	if ((previous < 0) || (next < 0)) throw invalid_argument("Event window size must not be negative");
+	freeSlots();
+	m_previous = previous;
+	m_next = next;
+	clear();
+}
+
+
+void EventWindow::add(ManagedBranch &branch) {
+	if (m_index.find(&branch) != m_index.end()) return;
+	void *test = branch.newValue();
+	if (test == 0) throw invalid_argument(Form("Branch \"%s\" doesn't support snapshots, can't add it to the event window", branch.name().Data()));
+	branch.deleteValue(test);
+	freeSlots();
+	m_index[&branch] = m_branches.size();
+	m_branches.push_back(&branch);
+}
+
+
+void EventWindow::inputFrom(const InputBranchManager &manager) {
+	if (!active()) return;
+	if (m_next > 0) {
+		// Processing is delayed, so the complete input has to be restored
+		vector<ManagedBranch*> inputs;
+		manager.inputBranches(inputs);
+		for (vector<ManagedBranch*>::iterator it = inputs.begin(); it != inputs.end(); ++it) add(**it);
+	}
+
+	freeSlots();
+	m_slots.resize(size_t(m_previous + 1 + m_next));
+	for (vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+		it->values.resize(m_branches.size());
+		for (size_t i = 0; i < m_branches.size(); ++i) it->values[i] = m_branches[i]->newValue();
+	}
+	clear();
+	log_debug("Event window: %i previous and %i next entries of %i branches", int(m_previous), int(m_next), int(m_branches.size()));
+}
+
+
+void EventWindow::push(Long64_t entry) {
+	if (m_slots.empty()) throw logic_error("Event window used before EventWindow::inputFrom()");
+	Slot &target = m_slots[size_t(m_pushed % Long64_t(m_slots.size()))];
+	target.entry = entry;
+	for (size_t i = 0; i < m_branches.size(); ++i)
+		m_branches[i]->copyValue(target.values[i], m_branches[i]->currentValue());
+	++m_pushed;
+}
+
+
+Long64_t EventWindow::advance() {
+	if (!pending()) throw logic_error("No buffered entry left in event window");
+	++m_current;
+	const Slot &current = slot(0);
+	if (m_next > 0) {
+		for (size_t i = 0; i < m_branches.size(); ++i)
+			m_branches[i]->copyValue(m_branches[i]->currentValue(), current.values[i]);
+	}
+	return current.entry;
+}
+
+
+Long64_t EventWindow::entry(Int_t offset) const {
+	if (!available(offset)) throw out_of_range(Form("No entry at offset %i in event window", int(offset)));
+	return slot(offset).entry;
+}
+
+
+void EventWindow::clear() {
+	m_pushed = 0;
+	m_current = -1;
+}
+
+
+EventWindow::EventWindow()
+	: m_previous(0), m_next(0), m_pushed(0), m_current(-1)
+{}
+
+
+EventWindow::~EventWindow() {
+	freeSlots();
+}
+
+
+} // namespace froast
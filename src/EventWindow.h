@@ -0,0 +1,147 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_EVENTWINDOW_H
+#define FROAST_EVENTWINDOW_H
+
+#include <vector>
+#include <map>
+
+#include <Rtypes.h>
+
+#include "BranchManager.h"
+
+
+namespace froast {
+
+
+///	@brief	Sliding window of branch values around the current entry
+///
+///	Keeps snapshots of the values of registered branches for up to
+///	previous() entries before and next() entries after the current one,
+///	in processing order, in a ring buffer. Entries are read only once.
+///
+///	TreeMapperSel uses a window with next() > 0 by delaying the processing
+///	of each entry until its successors have been read. All available input
+///	branches are then registered automatically, so the complete input
+///	state of the current entry can be restored before ProcessEntry().
+///	Selectors must not read input entries themselves in that case.
+///	The window is drained at the end of each tree of a TChain, so the last
+///	next() entries of a tree have no successors from the next tree.
+///
+///	Example (in a selector constructor):
+///
+///		window.resize(2, 2);
+///		window.add(energy);
+///
+///	and in ProcessEntry():
+///
+///		double previousEnergy = window.available(-1) ? window.at(energy, -1) : 0;
+
+class EventWindow {
+protected:
+	struct Slot {
+		Long64_t entry;
+		std::vector<void*> values;
+		Slot() : entry(-1) {}
+	};
+
+	Int_t m_previous;
+	Int_t m_next;
+
+	std::vector<ManagedBranch*> m_branches;
+	std::map<const ManagedBranch*, size_t> m_index;
+	std::vector<Slot> m_slots;
+
+	Long64_t m_pushed;
+	Long64_t m_current;
+
+	EventWindow(const EventWindow &);
+	EventWindow& operator=(const EventWindow &);
+
+	void freeSlots();
+
+	const Slot& slot(Int_t offset) const { return m_slots[size_t((m_current + offset) % Long64_t(m_slots.size()))]; }
+
+	const void* value(const ManagedBranch &branch, Int_t offset) const;
+
+public:
+	///	@brief	Set the number of previous and next entries to keep
+	void resize(Int_t previous, Int_t next);
+
+	Int_t previous() const { return m_previous; }
+	Int_t next() const { return m_next; }
+
+	bool active() const { return (m_previous > 0) || (m_next > 0); }
+
+	///	@brief	Register a branch
+	///
+	///	The branch type has to support snapshots (see ManagedBranch::newValue()).
+	void add(ManagedBranch &branch);
+
+	///	@brief	Allocate the buffers, and register the inputs of a branch manager if next() > 0
+	void inputFrom(const InputBranchManager &manager);
+
+	///	@brief	Store snapshots of the current values of the registered branches
+	///	@param	entry	Entry the values belong to
+	void push(Long64_t entry);
+
+	///	@brief	Check if enough entries are buffered to move to the next entry
+	bool ready() const { return m_pushed - m_current > m_next + 1; }
+
+	///	@brief	Check if there are buffered entries left to move to (at the end of the input)
+	bool pending() const { return m_current + 1 < m_pushed; }
+
+	///	@brief	Move to the next entry
+	///	@return	Entry number, as passed to push()
+	///
+	///	If next() > 0, restores the values of the registered branches for
+	///	the new current entry.
+	Long64_t advance();
+
+	///	@brief	Check if the entry at an offset from the current one is buffered
+	bool available(Int_t offset) const {
+		Long64_t position = m_current + offset;
+		return (offset >= -m_previous) && (offset <= m_next) && (position >= 0)
+			&& (position < m_pushed) && (position >= m_pushed - Long64_t(m_slots.size()));
+	}
+
+	///	@brief	Entry number at an offset from the current one
+	Long64_t entry(Int_t offset = 0) const;
+
+	template<typename A> const A& at(const ScalarBranch<A> &branch, Int_t offset) const
+		{ return *static_cast<const A*>(value(branch, offset)); }
+
+	template<typename A> const A& at(const ObjectBranch<A> &branch, Int_t offset) const
+		{ return *static_cast<const A*>(value(branch, offset)); }
+
+	template<typename A> const std::vector<A>& at(const VectorBranch<A> &branch, Int_t offset) const
+		{ return *static_cast< const std::vector<A>* >(value(branch, offset)); }
+
+	///	@brief	Forget all buffered entries
+	void clear();
+
+	EventWindow();
+	virtual ~EventWindow();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_EVENTWINDOW_H
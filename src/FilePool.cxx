@@ -0,0 +1,131 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "FilePool.h"
+
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include <TROOT.h>
+
+#include "LocalFile.h"
+#include "logging.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+FilePool& FilePool::global() {
+	// Never deleted, ROOT closes remaining files on exit:
+	static FilePool *pool = new FilePool;
+	return *pool;
+}
+
+
+void FilePool::evict(size_t maxOpen) {
+	while (m_slots.size() > maxOpen) {
+		Slots::iterator lru = m_slots.end();
+		for (Slots::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+			if ((it->second.refs == 0) && ((lru == m_slots.end()) || (it->second.lastUse < lru->second.lastUse)))
+				lru = it;
+		}
+		if (lru == m_slots.end()) break;
+		log_trace("Closing pooled file \"%s\"", lru->first.Data());
+		TFile *file = lru->second.file;
+		m_slots.erase(lru);
+		if (gDirectory == file) gROOT->cd();
+		file->Close();
+		delete file;
+	}
+}
+
+
+size_t FilePool::size() {
+	pthread_mutex_lock(&m_mutex);
+	size_t n = m_slots.size();
+	pthread_mutex_unlock(&m_mutex);
+	return n;
+}
+
+
+TFile* FilePool::acquire(const TString &fileName) {
+	pthread_mutex_lock(&m_mutex);
+	Slot &slot = m_slots[fileName];
+	if (slot.file == 0) {
+		TDirectory *oldDir = gDirectory;
+		TFile *file = TFile::Open(LocalFile::url(fileName), "read");
+		oldDir->cd();
+		if ((file == 0) || file->IsZombie()) {
+			delete file;
+			m_slots.erase(fileName);
+			pthread_mutex_unlock(&m_mutex);
+			throw runtime_error(string("Can't open input file ") + fileName.Data());
+		}
+		slot.file = file;
+		log_trace("Opened pooled file \"%s\"", fileName.Data());
+	}
+	++slot.refs;
+	slot.lastUse = ++m_clock;
+	TFile *file = slot.file;
+	if (m_slots.size() > m_maxOpen) evict(m_maxOpen);
+	pthread_mutex_unlock(&m_mutex);
+	return file;
+}
+
+
+void FilePool::release(TFile *file) {
+	if (file == 0) return;
+	pthread_mutex_lock(&m_mutex);
+	for (Slots::iterator it = m_slots.begin(); it != m_slots.end(); ++it) {
+		if (it->second.file == file) {
+			if (it->second.refs > 0) --it->second.refs;
+			break;
+		}
+	}
+	if (m_slots.size() > m_maxOpen) evict(m_maxOpen);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+void FilePool::clear() {
+	pthread_mutex_lock(&m_mutex);
+	evict(0);
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+FilePool::FilePool(size_t maxOpen)
+	: m_maxOpen(maxOpen), m_clock(0)
+{
+	if (m_maxOpen == 0) m_maxOpen = size_t(std::max(1, int(GSettings::get("froast.input.pool.size", 64))));
+	pthread_mutex_init(&m_mutex, 0);
+}
+
+
+FilePool::~FilePool() {
+	clear();
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+} // namespace froast
@@ -0,0 +1,117 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_FILEPOOL_H
+#define FROAST_FILEPOOL_H
+
+#include <map>
+
+#include <pthread.h>
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+
+
+namespace froast {
+
+
+///	@brief	Pool of open input files with LRU eviction
+///
+///	Files are opened read-only (via LocalFile::url) on first acquire() and
+///	stay open after release(), until the pool exceeds its maximum size and
+///	they are the least recently used ones not in use. Files in use are
+///	never closed, so the pool may temporarily grow beyond the maximum.
+///
+///	Files obtained from the pool must not be closed or deleted by the
+///	caller. Output trees cloned from pooled trees should be unlinked
+///	(TTree::GetListOfClones()) if they outlive the release.
+///
+///	Settings:
+///	- "froast.input.pool.size": Maximum number of open files (default: 64)
+
+class FilePool {
+protected:
+	struct Slot {
+		TFile *file;
+		Int_t refs;
+		ULong64_t lastUse;
+		Slot(): file(0), refs(0), lastUse(0) {}
+	};
+
+	typedef std::map<TString, Slot> Slots;
+
+	Slots m_slots;
+	size_t m_maxOpen;
+	ULong64_t m_clock;
+	pthread_mutex_t m_mutex;
+
+	void evict(size_t maxOpen);
+
+public:
+	static FilePool& global();
+
+	size_t maxOpen() const { return m_maxOpen; }
+	void maxOpen(size_t n) { m_maxOpen = n; }
+
+	///	@brief	Number of currently open files
+	size_t size();
+
+	///	@brief	Get an open file, opening it if necessary
+	///
+	///	Throws if the file can't be opened.
+	TFile* acquire(const TString &fileName);
+
+	///	@brief	Release a file obtained via acquire()
+	void release(TFile *file);
+
+	///	@brief	Close all files not in use
+	void clear();
+
+	///	@param	maxOpen	Maximum number of open files, 0 to use the setting
+	FilePool(size_t maxOpen = 0);
+	virtual ~FilePool();
+};
+
+
+///	@brief	Scoped reference to a file from a FilePool
+
+class PooledFile {
+protected:
+	FilePool *m_pool;
+	TFile *m_file;
+
+	PooledFile(const PooledFile &other);
+	PooledFile& operator=(const PooledFile &other);
+
+public:
+	TFile* get() const { return m_file; }
+	TFile* operator->() const { return m_file; }
+	TFile& operator*() const { return *m_file; }
+
+	PooledFile(const TString &fileName, FilePool &pool = FilePool::global())
+		: m_pool(&pool), m_file(pool.acquire(fileName)) {}
+
+	virtual ~PooledFile() { m_pool->release(m_file); }
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_FILEPOOL_H
@@ -0,0 +1,227 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "FileScheduler.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <RVersion.h>
+#include <TROOT.h>
+#include <TUrl.h>
+
+#include "logging.h"
+#include "PerfStats.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+bool FileScheduler::isRemote(const TString &fileName) {
+	if (fileName.Index("://") < 0) return false;
+	TString protocol = TUrl(fileName.Data()).GetProtocol();
+	return (protocol != "file");
+}
+
+
+void* FileScheduler::threadMain(void *arg) {
+	static_cast<FileScheduler*>(arg)->run();
+	return 0;
+}
+
+
+void FileScheduler::run() {
+	pthread_mutex_lock(&m_mutex);
+	while (true) {
+		while (m_jobs.empty() && !m_stop) pthread_cond_wait(&m_cond, &m_mutex);
+		if (m_jobs.empty() && m_stop) break;
+		Job job = m_jobs.front();
+		m_jobs.pop_front();
+		m_busy = true;
+		pthread_mutex_unlock(&m_mutex);
+
+		string error;
+		try { execute(job); }
+		catch (std::exception &e) { error = e.what(); }
+		catch (...) { error = "Unknown exception in file scheduler"; }
+
+		pthread_mutex_lock(&m_mutex);
+		if (!error.empty() && m_error.empty()) m_error = error;
+		m_busy = false;
+		pthread_cond_broadcast(&m_cond);
+	}
+	pthread_mutex_unlock(&m_mutex);
+}
+
+
+bool FileScheduler::startThread() {
+	if (m_threadStarted) return true;
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	if (m_asyncClose) ROOT::EnableThreadSafety();
+	#endif
+	if (pthread_create(&m_thread, 0, threadMain, this) != 0) {
+		log_warn("Can't start file scheduler thread, opening and closing files synchronously");
+		m_prefetch = false;
+		m_asyncClose = false;
+		return false;
+	}
+	m_threadStarted = true;
+	return true;
+}
+
+
+bool FileScheduler::enqueue(const Job &job) {
+	if (!startThread()) return false;
+	pthread_mutex_lock(&m_mutex);
+	m_jobs.push_back(job);
+	pthread_cond_broadcast(&m_cond);
+	pthread_mutex_unlock(&m_mutex);
+	return true;
+}
+
+
+void FileScheduler::closeNow(const Job &job) {
+	// Recorded in the process-wide totals when running in the helper thread
+	auto_ptr<PerfTimer> timer(job.phase.empty() ? 0 : new PerfTimer(job.phase));
+	job.output->Write(0, job.writeOption);
+	job.output->Close();
+	delete job.output;
+	if (job.input != 0) {
+		job.input->Close();
+		delete job.input;
+	}
+}
+
+
+void FileScheduler::execute(const Job &job) {
+	if (job.output != 0) {
+		log_debug("Closing output file \"%s\" in background", job.output->GetName());
+		closeNow(job);
+	} else {
+		warmLocal(job.fileName);
+	}
+}
+
+
+void FileScheduler::warmLocal(const TString &fileName) {
+	TString path = fileName;
+	if (path.BeginsWith("file:") || path.BeginsWith("mmap:") || path.BeginsWith("local:")) path = TUrl(fileName.Data()).GetFile();
+
+	int fd = ::open(path.Data(), O_RDONLY);
+	if (fd < 0) { log_debug("Can't prefetch \"%s\"", path.Data()); return; }
+
+	struct stat st;
+	if (fstat(fd, &st) == 0) {
+		Long64_t size = st.st_size;
+		Long64_t head = std::min(m_headBytes, size);
+		Long64_t tailStart = std::max(head, size - m_tailBytes);
+		#ifdef POSIX_FADV_WILLNEED
+		if (head > 0) posix_fadvise(fd, 0, head, POSIX_FADV_WILLNEED);
+		if (size > tailStart) posix_fadvise(fd, tailStart, size - tailStart, POSIX_FADV_WILLNEED);
+		#endif
+
+		// Read file header and tail (keys list, StreamerInfo) synchronously,
+		// so opening the file won't have to wait for them:
+		vector<char> buffer(1024 * 1024);
+		Long64_t pos = 0;
+		while (pos < size) {
+			if (pos == head) pos = tailStart;
+			Long64_t end = (pos < head) ? head : size;
+			size_t n = size_t(std::min(Long64_t(buffer.size()), end - pos));
+			if (n == 0) break;
+			ssize_t r = pread(fd, &buffer[0], n, pos);
+			if (r <= 0) break;
+			pos += r;
+		}
+		log_debug("Prefetched \"%s\"", path.Data());
+	}
+	::close(fd);
+}
+
+
+void FileScheduler::prefetch(const TString &fileName) {
+	if (!m_prefetch) return;
+	if (isRemote(fileName)) {
+		log_debug("Opening \"%s\" asynchronously", fileName.Data());
+		TFile::AsyncOpen(fileName.Data());
+	} else {
+		enqueue(Job(fileName));
+	}
+}
+
+
+void FileScheduler::close(TFile *output, TFile *input, Int_t writeOption, const std::string &phase) {
+	if (output == 0) return;
+	if ((gDirectory == output) || (gDirectory == input)) gROOT->cd();
+	Job job(output, input, writeOption, phase);
+	if (!(m_asyncClose && enqueue(job))) closeNow(job);
+}
+
+
+void FileScheduler::sync() {
+	pthread_mutex_lock(&m_mutex);
+	while (!m_jobs.empty() || m_busy) pthread_cond_wait(&m_cond, &m_mutex);
+	string error = m_error;
+	m_error.clear();
+	pthread_mutex_unlock(&m_mutex);
+	if (!error.empty()) throw runtime_error(error);
+}
+
+
+FileScheduler::FileScheduler()
+	: m_threadStarted(false), m_busy(false), m_stop(false)
+{
+	m_prefetch = GSettings::get("froast.input.prefetch", true);
+	m_headBytes = GSettings::get("froast.input.prefetch.head", 1024 * 1024);
+	m_tailBytes = GSettings::get("froast.input.prefetch.tail", 1024 * 1024);
+
+	m_asyncClose = false;
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	m_asyncClose = GSettings::get("froast.output.close.async", true);
+	#endif
+
+	pthread_mutex_init(&m_mutex, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+
+FileScheduler::~FileScheduler() {
+	if (m_threadStarted) {
+		pthread_mutex_lock(&m_mutex);
+		m_stop = true;
+		pthread_cond_broadcast(&m_cond);
+		pthread_mutex_unlock(&m_mutex);
+		pthread_join(m_thread, 0);
+	}
+	if (!m_error.empty()) log_error("%s", m_error.c_str());
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+
+} // namespace froast
@@ -0,0 +1,127 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_FILESCHEDULER_H
+#define FROAST_FILESCHEDULER_H
+
+#include <deque>
+#include <string>
+
+#include <pthread.h>
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+
+
+namespace froast {
+
+
+///	@brief	Overlaps file opening and closing with processing
+///
+///	Warms up input files that will be processed next and writes and closes
+///	finished output files in a helper thread, while the caller processes
+///	the current file.
+///
+///	The head and the tail (keys and StreamerInfo) of local input files are
+///	pulled into the OS page cache, the rest is left to the kernel's
+///	read-ahead while the file is read, so the pages of the current file
+///	aren't evicted. Remote files are opened asynchronously via
+///	TFile::AsyncOpen, so a later TFile::Open of the same URL picks up the
+///	pending open.
+///
+///	Output files can only be closed in the background with ROOT 6 and
+///	above (requires ROOT::EnableThreadSafety()), otherwise close() writes
+///	and closes synchronously.
+///
+///	The helper thread is only started with the first background job.
+///
+///	Settings:
+///	- "froast.input.prefetch": Enable input prefetching (default: true)
+///	- "froast.input.prefetch.head", "froast.input.prefetch.tail": Bytes to
+///	  read at the start and end of a local file (default: 1 MB each)
+///	- "froast.output.close.async": Write and close outputs in the
+///	  background (default: true)
+
+class FileScheduler {
+protected:
+	struct Job {
+		TString fileName;
+		TFile *output;
+		TFile *input;
+		Int_t writeOption;
+		std::string phase;
+		Job(const TString &name) : fileName(name), output(0), input(0), writeOption(0) {}
+		Job(TFile *out, TFile *in, Int_t opt, const std::string &perfPhase)
+			: output(out), input(in), writeOption(opt), phase(perfPhase) {}
+	};
+
+	bool m_prefetch;
+	bool m_asyncClose;
+	Long64_t m_headBytes;
+	Long64_t m_tailBytes;
+
+	pthread_t m_thread;
+	bool m_threadStarted;
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_cond;
+	std::deque<Job> m_jobs;
+	bool m_busy;
+	bool m_stop;
+	std::string m_error;
+
+	static void* threadMain(void *arg);
+	void run();
+	bool startThread();
+	bool enqueue(const Job &job);
+	void execute(const Job &job);
+	void warmLocal(const TString &fileName);
+
+	static void closeNow(const Job &job);
+	static bool isRemote(const TString &fileName);
+
+public:
+	///	@brief	Schedule warm-up of an input file
+	void prefetch(const TString &fileName);
+
+	///	@brief	Write, close and delete an output file
+	///	@param	output	Output file
+	///	@param	input	Input file to close and delete after the output file (optional)
+	///	@param	writeOption	Option for TFile::Write
+	///	@param	phase	PerfStats phase to record the time of writing and closing as (optional)
+	///
+	///	Takes ownership of the files. The caller must not access the files or
+	///	any object in them after calling this. Pass the input file of trees
+	///	that have been cloned into output, as trees and their clones are
+	///	linked.
+	void close(TFile *output, TFile *input = 0, Int_t writeOption = 0, const std::string &phase = "");
+
+	///	@brief	Wait for all scheduled jobs to finish
+	///
+	///	Throws if a background job failed.
+	void sync();
+
+	FileScheduler();
+	virtual ~FileScheduler();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_FILESCHEDULER_H
@@ -26,7 +26,12 @@
 #include <memory>
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
 
+#include <pthread.h>
+
+#include <TROOT.h>
+#include <TClass.h>
 #include <TFile.h>
 #include <TObjArray.h>
 #include <TChainElement.h>
@@ -40,6 +45,15 @@
 #include "File.h"
 #include "Settings.h"
 #include "TreeEntryList.h"
+#include "ChainIndex.h"
+#include "FilePool.h"
+#include "FileScheduler.h"
+#include "LocalFile.h"
+#include "OutputClusters.h"
+#include "OutputCompression.h"
+#include "OutputMerger.h"
+#include "PerfStats.h"
+#include "ProgressReporter.h"
 
 
 using namespace std;
@@ -73,7 +87,7 @@ void FroastTools::copyObject(TDirectory *tdir, const TString &objName) {
 	if (keepObj != 0) {
 		TTree *keepTree = dynamic_cast<TTree*>(keepObj);
 		if (keepTree != 0) {
-			TTree *cloned = keepTree->CloneTree();
+			TTree *cloned = cloneTree(keepTree);
 			cloned->Write();
 		}
 	} else {
@@ -82,53 +96,135 @@ void FroastTools::copyObject(TDirectory *tdir, const TString &objName) {
 }
 
 
+TTree* FroastTools::cloneTree(TTree *inputTree) {
+	OutputClusters::Policy policy = OutputClusters::policy();
+	if (policy == OutputClusters::CP_DEFAULT) return inputTree->CloneTree();
+	// ROOT falls back to a regular copy if fast cloning isn't possible
+	if (policy == OutputClusters::CP_INPUT) return inputTree->CloneTree(-1, "fast");
+
+	TTree *outputTree = inputTree->CloneTree(0);
+	if (outputTree == 0) throw runtime_error(Form("Can't clone tree \"%s\"", inputTree->GetName()));
+	OutputClusters::configure(outputTree, inputTree);
+	outputTree->CopyEntries(inputTree);
+	return outputTree;
+}
+
+
+TTree* FroastTools::copyTree(TTree *inputTree, const TString &selection, Long64_t nEntries, Long64_t startEntry) {
+	// Single pass like TTree::CopyTree, but clone and fill separately, to
+	// set up the clusters of the output in between and to report progress
+	TTree *outputTree = inputTree->CloneTree(0);
+	if (outputTree == 0) throw runtime_error(Form("Can't clone tree \"%s\"", inputTree->GetName()));
+	if (OutputClusters::policy() != OutputClusters::CP_DEFAULT)
+		OutputClusters::configure(outputTree, inputTree);
+
+	auto_ptr<TTreeFormula> select;
+	if (selection.Length() > 0) {
+		select.reset(new TTreeFormula("froastCopyTreeSelect", selection.Data(), inputTree));
+		if (select->GetNdim() == 0) throw invalid_argument(Form("Invalid selection \"%s\"", selection.Data()));
+	}
+
+	ProgressReporter progress;
+	progress.begin("Copying", ProgressReporter::totalEntries(inputTree, nEntries, startEntry));
+	if (nEntries < 0) nEntries = numeric_limits<Long64_t>::max();
+
+	Int_t treeNumber = -1;
+	for (Long64_t entry = startEntry; entry - startEntry < nEntries; ++entry) {
+		// Entry numbers respect the event or entry list of the input tree
+		Long64_t entryNumber = inputTree->GetEntryNumber(entry);
+		if (entryNumber < 0) break;
+		if (inputTree->LoadTree(entryNumber) < 0) break;
+		if (inputTree->GetTreeNumber() != treeNumber) {
+			treeNumber = inputTree->GetTreeNumber();
+			if (select.get() != 0) select->UpdateFormulaLeaves();
+			progress.file(inputTree);
+		}
+		progress.entry();
+
+		if (select.get() != 0) {
+			Int_t ndata = select->GetNdata();
+			bool keep = false;
+			for (Int_t i = 0; (i < ndata) && !keep; ++i) keep = (select->EvalInstance(i) != 0);
+			if (!keep) continue;
+		}
+		inputTree->GetEntry(entryNumber);
+		outputTree->Fill();
+	}
+	progress.end();
+	return outputTree;
+}
+
+
 void FroastTools::mapMulti(TChain *chain, const TString &selector, const TString &tag, const TString &keep) {
 	
 	///	For the syntax of the selector expression see masSingle
 
+	FileScheduler scheduler;
 	TObjArray *chainElems = chain->GetListOfFiles();
 	for (int chainEntry = 0; chainEntry < chainElems->GetEntriesFast(); ++chainEntry) {
 		TChainElement *e = dynamic_cast<TChainElement*>(chainElems->At(chainEntry));
 		string treeName = e->GetName();
 		string inFileName = e->GetTitle();
+		if (chainEntry + 1 < chainElems->GetEntriesFast())
+			scheduler.prefetch(chainElems->At(chainEntry + 1)->GetTitle());
 
 		///	The name of the output files  is created from the filenames
 		///	of the TTrees concatenated in the TChain.
 		string outFileName = (File(inFileName).base() % tag.Data()).path();
 		cerr << "Mapping " << inFileName << ":" << treeName << " to " << outFileName << endl;
 
-		TFile inFile(inFileName.c_str(), "read");
-		TTree *inTree; inFile.GetObject(treeName.c_str(), inTree);
+		PerfStats fileStats;
+		PerfStats::Scope perfScope(fileStats);
+		PerfTimer openTimer("mapMulti.open");
+		auto_ptr<TFile> inFile(TFile::Open(LocalFile::url(inFileName.c_str()), "read"));
+		if ((inFile.get() == 0) || inFile->IsZombie()) throw runtime_error(string("Can't open input file ") + inFileName);
+		TTree *inTree; inFile->GetObject(treeName.c_str(), inTree);
 		
-		TFile outFile(outFileName.c_str(), "recreate");
-		outFile.SetCompressionLevel(GSettings::get("froast.tfile.compression.level", 1));
+		auto_ptr<TFile> outFile(new TFile(outFileName.c_str(), "recreate"));
+		OutputCompression::configure(outFile.get());
+		openTimer.stop();
 
+		PerfTimer compileTimer("mapMulti.compile");
 		TSelector *sel = TSelector::GetSelector(selector.Data());
 		if (sel == 0) throw runtime_error(string("Cannot load selector ") + selector.Data());
+		compileTimer.stop();
+		PerfTimer processTimer("mapMulti.process");
 		inTree->Process(sel);
+		processTimer.stop();
 		delete sel;
 
+		PerfTimer writeTimer("mapMulti.write");
 		TObjArray* keeps = keep.Tokenize(",");
 		for (int i = 0; i < keeps->GetEntriesFast(); ++i) {
 			TString keepObjName = dynamic_cast<TObjString*>(keeps->At(i))->GetString().Strip(TString::kBoth);
 			cerr << "Copying object " << keepObjName << " to output" << endl;
-			copyObject(&inFile, keepObjName);
+			copyObject(inFile.get(), keepObjName);
 		}
 		delete keeps;
 		
-		Settings::global().writeToGDirectory();
-		outFile.Write();
-		outFile.Close();
-		inFile.Close();
+		Settings::current().saveDefaults();
+		Settings::current().writeToGDirectory();
+		writeTimer.stop();
+		fileStats.writeToGDirectory();
+		TFile *output = outFile.release();
+		scheduler.close(output, inFile.release(), 0, "mapMulti.close");
 	}
+	scheduler.sync();
 }
 
 
-void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, const TString &outFileName, bool noRecompile) {
-	TFile inFile(inFileName.Data(), "read");
-	TFile outFile(outFileName.Data(), "recreate");
-	outFile.SetCompressionLevel(GSettings().get("froast.tfile.compression.level", 1));
-	Settings::global().read(&inFile);
+void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, const TString &outFileName, bool noRecompile, FileScheduler *scheduler) {
+	///	The time spent in each phase (open, per mapper, write) is stored
+	///	in the output file as "froast.perf", see PerfStats.
+	PerfStats fileStats;
+	PerfStats::Scope perfScope(fileStats);
+	PerfTimer openTimer("mapSingle.open");
+	auto_ptr<TFile> inFile(TFile::Open(LocalFile::url(inFileName), "read"));
+	if ((inFile.get() == 0) || inFile->IsZombie()) throw runtime_error(string("Can't open input file ") + inFileName.Data());
+	auto_ptr<TFile> outFile(new TFile(outFileName.Data(), "recreate"));
+	OutputCompression::configure(outFile.get());
+	Settings::current().read(inFile.get());
+	openTimer.stop();
 
 	TPRegexp mapperSpecExpr("^([^(]*)\\((.*)\\)$");
 	TPRegexp xxExp("\\+\\+$"); // selecor compile option
@@ -156,9 +252,14 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 		cerr << "Applying " << fctName << "(";
 		for (size_t i = 0; i < fctArgs.size(); ++i) cerr << (i>0 ? "," : "") << fctArgs[i];
 		cerr << ")" << endl;
+
+		TString mapperName = fctName; mapperName.Remove(TString::kTrailing, '+');
+		const string phase = string("mapSingle.") + mapperName.Data();
 		
-		TObject *inObj; inFile.GetObject(objName.Data(), inObj);
+		PerfTimer getTimer(phase + ".get");
+		TObject *inObj; inFile->GetObject(objName.Data(), inObj);
 		if (inObj == 0) throw runtime_error(string("Object ") + objName.Data() + " not found in TDirectory");
+		getTimer.stop();
 
 		TTree *inTree = dynamic_cast<TTree*>(inObj);
 		if (inTree != 0) {
@@ -168,7 +269,8 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 				///	copied to a new file. Up to 5 arguments are allowed, example \n
 				///	copy(tree, branches, selection, nentries, firstentry)
 				if (fctArgs.size() <= 1) {
-					inTree->CloneTree();
+					PerfTimer processTimer(phase + ".process");
+					cloneTree(inTree);
 				} else {
 					///	The ordering of the arguments to the mapper are expected to be
 					///	<ol>
@@ -226,7 +328,7 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 						if (!friendExpr.Substitute(friends[i], "$2")) continue;
 						if (friends[i]==inTree->GetName()) continue;
 						if (inTree->GetFriend(friends[i])) continue;
-						TObject* friendObj; inFile.GetObject(friends[i], friendObj);
+						TObject* friendObj; inFile->GetObject(friends[i], friendObj);
 						if (friendObj==0) throw runtime_error(string("Friend tree ")+friends[i].Data()+" not found in TDirectory");
 						TTree* friendTree=dynamic_cast<TTree*>(friendObj);
 						if (friendTree==0) throw runtime_error(string("Object ")+friends[i].Data()+" is not of type TTree");
@@ -235,7 +337,9 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 						cerr << "Adding friend tree " << friends[i] << endl;
 					}
 					
-					TTree* outTree = inTree->CopyTree(selection.Data(), "", nEntries, startEntry);
+					PerfTimer processTimer(phase + ".process");
+					TTree* outTree = copyTree(inTree, selection, nEntries, startEntry);
+					processTimer.stop();
 					if (outTreeName != outTree->GetName()) outTree->SetName(outTreeName.Data());
 					inTree->SetBranchStatus("*", 1, &found); // reactivate branches for later use
 					if (inTree->GetListOfFriends()) inTree->GetListOfFriends()->Clear();
@@ -260,6 +364,7 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 				Long64_t startEntry = (fctArgs.size() > 5) ? atol(fctArgs[5]) : 0;
 				if (fctArgs.size() > 6) throw invalid_argument(string("Invalid number of parameters for operation ") + fctName.Data() + ", expecting 1 to 6.");
 
+				PerfTimer processTimer(phase + ".process");
 				inTree->Draw(varexp.Data(), selection.Data(), (TString("goff ")+option).Data(), nEntries, startEntry);
 			} else {
 				///	If as argument / mapper the name of a selector is given the syntax is \n
@@ -274,18 +379,33 @@ void FroastTools::mapSingle(const TString &inFileName, const TString &mappers, c
 				Long64_t startEntry = (fctArgs.size() > 3) ? atol(fctArgs[3]) : 0;
 				if (fctArgs.size() > 4) throw invalid_argument(string("Invalid number of parameters for operation ") + fctName.Data() + ", expecting 1 to 4.");
 
+				PerfTimer compileTimer(phase + ".compile");
 				TSelector *sel = TSelector::GetSelector(fctName.Data());
 				if (sel == 0) throw runtime_error(string("Cannot load selector ") + fctName.Data());
+				compileTimer.stop();
+				PerfTimer processTimer(phase + ".process");
 				inTree->Process(sel, option.Data(), nEntries, startEntry);
+				processTimer.stop();
 				delete sel;
 			}
 		} else throw invalid_argument(string("Objects of type ") + inObj->Class()->GetName() + " not supported yet");
 	}
 	
-	Settings::global().writeToGDirectory();
-	outFile.Write(0,TObject::kOverwrite);
-	outFile.Close();
-	inFile.Close();
+	PerfTimer writeTimer("mapSingle.write");
+	Settings::current().saveDefaults();
+	Settings::current().writeToGDirectory();
+	writeTimer.stop();
+	// Closing isn't part of the stored record, it happens after writing it
+	fileStats.writeToGDirectory();
+	if (scheduler != 0) {
+		TFile *output = outFile.release();
+		scheduler->close(output, inFile.release(), TObject::kOverwrite, "mapSingle.close");
+	} else {
+		PerfTimer closeTimer("mapSingle.close");
+		outFile->Write(0,TObject::kOverwrite);
+		outFile->Close();
+		inFile->Close();
+	}
 }
 
 
@@ -298,33 +418,273 @@ void FroastTools::mapMulti(const TString &fileName, const TString &mappers, cons
 	TChain chain("");
 	chain.Add(fileName.Data());
 	TObjArray *chainElems = chain.GetListOfFiles();
-	// Save a copy of gEnv for later
-	TEnv* tenv_copy=(TEnv*)Settings::global().tenv()->Clone();
+	// Before the layer, so the defaults it saves are kept for all files
+	FileScheduler scheduler;
+	// Settings read from each input file are undone after mapping it
+	Settings::Layer fileSettings(Settings::current());
 	for (int chainEntry = 0; chainEntry < chainElems->GetEntriesFast(); ++chainEntry) {
 		TChainElement *e = dynamic_cast<TChainElement*>(chainElems->At(chainEntry));
 		string inFileName = e->GetTitle();
+		if (chainEntry + 1 < chainElems->GetEntriesFast())
+			scheduler.prefetch(chainElems->At(chainEntry + 1)->GetTitle());
 
 		string outFileName = (File(inFileName).base() % tag.Data()).path();
 		cerr << "Mapping " << inFileName << " to " << outFileName << endl;
 		// Don't recompile even if fct ends with "++" after first run:
-		mapSingle(inFileName, mappers, outFileName, (chainEntry > 0) || noRecompile);
-		// Reset gEnv to old state
-		Settings::global().table()->Clear();
-		TIter next(tenv_copy->GetTable(), kIterForward);
-		while (TEnvRec *record = dynamic_cast<TEnvRec*>(next()))
-			Settings::global().tenv()->SetValue(record->GetName(), record->GetValue(), record->GetLevel());
-	}
-	delete tenv_copy;
+		mapSingle(inFileName, mappers, outFileName, (chainEntry > 0) || noRecompile, &scheduler);
+		fileSettings.restore();
+	}
+	scheduler.sync();
 	cerr << "FroastTools::map(...) finished" << endl;
 }
 
 
+namespace {
+
+// Wraps the selector of a reduce, reading the settings of each input file
+// before its entries are processed
+struct TSelectorWrapper : public TSelector {
+	TSelector *wrapped;
+	TChain* chain;
+	Settings::Layer fileSettings; // settings of the last file are kept
+	bool haveHash;
+	uint64_t fileSettingsHash;
+	FileScheduler *scheduler;
+	/// selectorClass: create the selector from an already loaded class instead of by name
+	TSelectorWrapper(const char* name, TChain &inchain, FileScheduler *sched, TClass *selectorClass = 0) : chain(&inchain), fileSettings(Settings::current(), false), scheduler(sched) {
+/// read GEnv of first input file before selector gets constructed
+		haveHash = Settings::storedHash(chain->GetFile(), fileSettingsHash);
+		Settings::current().read(chain->GetFile());
+		wrapped = (selectorClass != 0) ? static_cast<TSelector*>(selectorClass->New()) : TSelector::GetSelector(name);
+		if (wrapped == 0) throw runtime_error(string("Cannot load selector ") + name);
+	};
+/// read GEnv of next input file if necessary
+	Bool_t Process(Long64_t entry) {
+		if (entry==0) {
+			// files of one production usually share their settings
+			uint64_t hash = 0;
+			bool hashed = Settings::storedHash(chain->GetFile(), hash);
+			if (!(hashed && haveHash && (hash == fileSettingsHash))) {
+				fileSettings.restore();
+				Settings::current().read(chain->GetFile());
+			}
+			haveHash = hashed;
+			fileSettingsHash = hash;
+			// warm up the next file of the chain while this one is processed
+			TObjArray *chainElems = chain->GetListOfFiles();
+			if (chain->GetTreeNumber() + 1 < chainElems->GetEntriesFast())
+				scheduler->prefetch(chainElems->At(chain->GetTreeNumber() + 1)->GetTitle());
+		}
+		return wrapped->Process(entry);
+	}
+	~TSelectorWrapper() {
+		delete wrapped;
+	}
+/// forward other important virtuals here
+	inline void Init(TTree* t) {wrapped->Init(t); chain=dynamic_cast<TChain*>(t);}
+	inline void Begin(TTree* t) {wrapped->Begin(t);}
+	inline void SlaveBegin(TTree* t) {wrapped->SlaveBegin(t);}
+	inline Bool_t Notify() {return wrapped->Notify();}
+	inline Bool_t ProcessCut(Long64_t entry) {return wrapped->ProcessCut(entry);}
+	inline void ProcessFill(Long64_t entry) {wrapped->ProcessFill(entry);}
+	inline void SlaveTerminate() {wrapped->SlaveTerminate();}
+	inline void Terminate() {wrapped->Terminate();}
+	inline int Version() const {return wrapped->Version();}
+};
+
+
+// Part of the input files of a parallel reduce, processed by a thread of
+// its own, with its own settings context
+struct ReduceTask {
+	TString selectorName;
+	TClass *selectorClass;
+	TString option;
+	std::string phase;
+	TChain *chain;
+	Settings settings;
+	PerfStats stats;
+	std::string error;
+	pthread_t thread;
+
+	static void* threadMain(void *arg) {
+		ReduceTask *task = static_cast<ReduceTask*>(arg);
+		try { task->run(); }
+		catch (std::exception &e) { task->error = e.what(); }
+		catch (...) { task->error = "Unknown exception in reduce thread"; }
+		return 0;
+	}
+
+	void run() {
+		Settings::Scope settingsScope(settings);
+		PerfStats::Scope perfScope(stats);
+		// Objects the selector creates in the current directory end up in
+		// the output, as with a sequential reduce
+		TDirectory *writer = OutputMerger::active()->openWriter();
+		writer->cd();
+		{
+			FileScheduler scheduler;
+			TSelectorWrapper w(selectorName.Data(), *chain, &scheduler, selectorClass);
+			PerfTimer processTimer(phase + ".process");
+			chain->Process(&w, option.Data());
+		}
+		gROOT->cd();
+		OutputMerger::active()->closeWriter(writer);
+	}
+
+	ReduceTask(const Settings &taskSettings)
+		: selectorClass(0), chain(0), settings(taskSettings) {}
+
+	~ReduceTask() { delete chain; }
+};
+
+
+// Runs a reduce with a single selector in several threads, writing into
+// one output file via an OutputMerger. Returns false, without writing
+// anything, if the mappers or the ROOT version don't allow this.
+bool reduceParallel(const TString &inFileNames, const TString &mappers, const TString &outFileName, bool noRecompile, size_t nThreads) {
+	vector<TString> mapperSpecs;
+	Util::split(mappers, ";", mapperSpecs, TString::kBoth);
+	vector<TString> mapperFctArgs;
+	static TPRegexp mapperSpecExpr("^([^(]*)\\((.*)\\)$");
+	if (mapperSpecs.size() == 1) Util::match(mapperSpecs[0], mapperSpecExpr, mapperFctArgs, TString::kBoth);
+	vector<TString> fctArgs;
+	if (mapperFctArgs.size() == 3) Util::split(mapperFctArgs[2], ",", fctArgs, TString::kBoth);
+	// Entry ranges refer to the whole input, so they can't be split up
+	if ((mapperFctArgs.size() != 3) || (mapperFctArgs[1] == "copy") || (fctArgs.size() < 1) || (fctArgs.size() > 2)) {
+		log_info("Parallel reduce needs a single selector without entry range, running sequentially");
+		return false;
+	}
+	if (!OutputMerger::supported()) {
+		log_warn("Parallel reduce not supported by this ROOT version, running sequentially");
+		return false;
+	}
+
+	TString fctName = mapperFctArgs[1];
+	static TPRegexp xxExp("\\+\\+$");
+	if (noRecompile) xxExp.Substitute(fctName, "+");
+	TString objName = fctArgs[0];
+	TString option = (fctArgs.size() > 1) ? fctArgs[1] : TString("");
+	TString mapperName = fctName; mapperName.Remove(TString::kTrailing, '+');
+	const string phase = string("reduce.") + mapperName.Data();
+
+	PerfStats fileStats;
+	PerfStats::Scope perfScope(fileStats);
+
+	PerfTimer getTimer(phase + ".get");
+	vector<TString> inFileList;
+	Util::split(inFileNames, " ", inFileList);
+	TChain inChain(objName);
+	for (vector<TString>::const_iterator f = inFileList.begin(); f != inFileList.end(); ++f) inChain.Add(*f);
+	ChainIndex::apply(&inChain);
+	LocalFile::applyTo(&inChain);
+	TObjArray *chainElems = inChain.GetListOfFiles();
+	if (chainElems->GetEntries() == 0)
+		throw runtime_error(string("No files found to match ") + (const char*)inFileNames);
+	if (inChain.GetListOfBranches() == 0)
+		throw runtime_error(string("Object ") + objName.Data() + " not found in TDirectory");
+	getTimer.stop();
+	nThreads = std::min(nThreads, size_t(chainElems->GetEntries()));
+	if (nThreads < 2) {
+		log_info("Only one input file, running reduce sequentially");
+		return false;
+	}
+
+	// Compile and load the selector once, with the settings of the first
+	// file, the threads create their instances from its class
+	PerfTimer compileTimer(phase + ".compile");
+	Settings::Layer fileSettings(Settings::current());
+	Settings::current().read(inChain.GetFile());
+	TSelector *selector = TSelector::GetSelector(fctName.Data());
+	if (selector == 0) throw runtime_error(string("Cannot load selector ") + fctName.Data());
+	TClass *selectorClass = selector->IsA();
+	delete selector;
+	fileSettings.restore();
+	compileTimer.stop();
+	if ((selectorClass == TSelector::Class()) || !selectorClass->IsLoaded()) {
+		log_info("Selector \"%s\" isn't compiled or has no dictionary, running reduce sequentially", fctName.Data());
+		return false;
+	}
+
+	cerr << "Applying " << fctName << " in " << nThreads << " threads" << endl;
+
+	PerfTimer openTimer("reduce.open");
+	int32_t compression = OutputCompression::profileSettings(OutputCompression::profile());
+	if (compression < 0) compression = GSettings::get("froast.tfile.compression.level", 1);
+	auto_ptr<OutputMerger> merger(new OutputMerger(outFileName, compression));
+	OutputMerger::activate(merger.get());
+	openTimer.stop();
+
+	// Consecutive input files per thread
+	vector<ReduceTask*> tasks;
+	size_t nFiles = chainElems->GetEntries();
+	for (size_t t = 0; t < nThreads; ++t) {
+		ReduceTask *task = new ReduceTask(Settings::current());
+		tasks.push_back(task);
+		task->selectorName = fctName;
+		task->selectorClass = selectorClass;
+		task->option = option;
+		task->phase = phase;
+		task->chain = new TChain(objName);
+		for (size_t i = t * nFiles / nThreads; i < (t + 1) * nFiles / nThreads; ++i) {
+			TChainElement *e = dynamic_cast<TChainElement*>(chainElems->At(i));
+			if (e != 0) task->chain->AddFile(e->GetTitle(), e->GetEntries());
+		}
+	}
+
+	size_t started = 0;
+	for (; started < tasks.size(); ++started)
+		if (pthread_create(&tasks[started]->thread, 0, ReduceTask::threadMain, tasks[started]) != 0) break;
+	for (size_t t = 0; t < started; ++t) pthread_join(tasks[t]->thread, 0);
+
+	string error = (started < tasks.size()) ? "Can't start reduce thread" : "";
+	for (size_t t = 0; t < tasks.size(); ++t) {
+		if (error.empty()) error = tasks[t]->error;
+		const PerfStats::Totals &totals = tasks[t]->stats.totals();
+		for (PerfStats::Totals::const_iterator it = totals.begin(); it != totals.end(); ++it)
+			fileStats.add(it->first, it->second.seconds, it->second.calls);
+	}
+	TFile *lastFile = tasks.back()->chain->GetFile();
+	if (error.empty()) {
+		// add settings of last file at the end
+		PerfTimer writeTimer("reduce.write");
+		if (lastFile != 0) Settings::current().read(lastFile);
+		Settings::current().saveDefaults();
+		TDirectory *oldDir = gDirectory;
+		TDirectory *writer = merger->openWriter();
+		writer->cd();
+		Settings::current().writeToGDirectory();
+		writeTimer.stop();
+		fileStats.writeToGDirectory();
+		oldDir->cd();
+		merger->closeWriter(writer);
+	}
+	for (size_t t = 0; t < tasks.size(); ++t) delete tasks[t];
+	if (!error.empty()) throw runtime_error(error);
+
+	PerfTimer closeTimer("reduce.close");
+	merger.reset();
+	return true;
+}
+
+} // namespace
+
+
 void FroastTools::reduce(const TString &inFileNames, const TString &mappers, const TString &outFileName, bool noRecompile) {
 	cerr << TString::Format("FroastTools::reduce(%s, %s, %s)", inFileNames.Data(), mappers.Data(), outFileName.Data()) << endl;
+	int32_t nThreads = GSettings::get("froast.reduce.threads", 1);
+	if ((nThreads > 1) && reduceParallel(inFileNames, mappers, outFileName, noRecompile, nThreads)) {
+		cerr << "FroastTools::reduce(...) finished" << endl;
+		return;
+	}
 	vector<TString> inFileList;
 	Util::split(inFileNames, " ", inFileList);
+	PerfStats fileStats;
+	PerfStats::Scope perfScope(fileStats);
+	PerfTimer openTimer("reduce.open");
 	TFile outFile(outFileName, "recreate");
-	outFile.SetCompressionLevel(GSettings().get("froast.tfile.compression.level", 1));
+	OutputCompression::configure(&outFile);
+	FileScheduler scheduler;
+	openTimer.stop();
 
 	vector<TString> mapperSpecs; // mapper expressions
 	/// Mappers (selectors, draw/scan options) are separated by ";"
@@ -350,16 +710,24 @@ void FroastTools::reduce(const TString &inFileNames, const TString &mappers, con
 		for (size_t i = 0; i < fctArgs.size(); ++i) cerr << (i>0 ? "," : "") << fctArgs[i];
 		cerr << ")" << endl;
 
+		TString mapperName = fctName; mapperName.Remove(TString::kTrailing, '+');
+		const string phase = string("reduce.") + mapperName.Data();
+
+		PerfTimer getTimer(phase + ".get");
 		TChain inChain(objName);
 		inChain.ResetBranchAddresses(); // may not do anything
 		for (vector<TString>::iterator f=inFileList.begin();f!=inFileList.end();f++) inChain.Add(*f);
+		ChainIndex::apply(&inChain);
+		LocalFile::applyTo(&inChain);
 		if (inChain.GetListOfFiles()->GetEntries()==0)
 			throw runtime_error(string("No files found to match ") + (const char*)inFileNames);
 		if (inChain.GetListOfBranches()==0)
 			throw runtime_error(string("Object ") + objName.Data() + " not found in TDirectory");
+		getTimer.stop();
 		if (fctName == "copy")
 			if (fctArgs.size() <= 1) {
-				inChain.CloneTree();
+				PerfTimer processTimer(phase + ".process");
+				cloneTree(&inChain);
 			} else {
 				///	The ordering of the arguments to the mapper are expected to be
 				///	<ol>
@@ -417,6 +785,8 @@ void FroastTools::reduce(const TString &inFileNames, const TString &mappers, con
 					TChain* friendChain=new TChain(friends[i]);
 					friendChains.push_back(friendChain);
 					for (vector<TString>::iterator f=inFileList.begin();f!=inFileList.end();f++) friendChain->Add(*f);
+					ChainIndex::apply(friendChain);
+					LocalFile::applyTo(friendChain);
 					if (friendChain->GetEntry(0)==0)
 						throw runtime_error(string("Invalid friend chain specification: ") + friendChain->GetName());
 					inChain.AddFriend(friendChain, friendChain->GetName());
@@ -425,7 +795,9 @@ void FroastTools::reduce(const TString &inFileNames, const TString &mappers, con
 					cerr << "Adding friend chain " << friendChain->GetName() << endl;
 				}
 			
-				TTree* outTree = inChain.CopyTree(selection.Data(), "", nEntries, startEntry);
+				PerfTimer processTimer(phase + ".process");
+				TTree* outTree = copyTree(&inChain, selection, nEntries, startEntry);
+				processTimer.stop();
 				if (outTreeName != outTree->GetName()) outTree->SetName(outTreeName.Data());
 				inChain.SetBranchStatus("*", 1, &found); // reactivate branches for later use
 				if (inChain.GetListOfFriends()) inChain.GetListOfFriends()->Clear();
@@ -439,54 +811,23 @@ void FroastTools::reduce(const TString &inFileNames, const TString &mappers, con
 			Long64_t startEntry = (fctArgs.size() > 3) ? atol(fctArgs[3]) : 0;
 			if (fctArgs.size() > 4) throw invalid_argument(string("Invalid number of parameters for operation ") + fctName.Data() + ", expecting 1 to 4.");
 
-			// define a class that wraps the TSelector real quick. Apparently doing
-			// this right here is still valid C++, however lord forbid if I wanted to
-			// define a function!!!
-			struct TSelectorWrapper : public TSelector {
-				TSelector *wrapped;
-				TChain* chain;
-				TEnv* tenv_copy;
-				TSelectorWrapper(const char* name, TChain &inchain) : chain(&inchain) {
-			/// read GEnv of first input file before selector gets constructed
-					tenv_copy=(TEnv*)Settings::global().tenv()->Clone();
-					Settings::global().read(chain->GetFile());
-					wrapped = TSelector::GetSelector(name);
-					if (wrapped == 0) throw runtime_error(string("Cannot load selector ") + name);
-				};
-			/// read GEnv of next input file if necessary
-				Bool_t Process(Long64_t entry) {
-					if (entry==0) {
-						Settings::global().table()->Clear();
-						TIter next(tenv_copy->GetTable(), kIterForward);
-						while (TEnvRec *record = dynamic_cast<TEnvRec*>(next()))
-							Settings::global().tenv()->SetValue(record->GetName(), record->GetValue(), record->GetLevel());
-						Settings::global().read(chain->GetFile());
-					}
-					return wrapped->Process(entry);
-				}
-				~TSelectorWrapper() {
-					delete wrapped;
-					delete tenv_copy;
-				}
-			/// forward other important virtuals here
-				inline void Init(TTree* t) {wrapped->Init(t); chain=dynamic_cast<TChain*>(t);}
-				inline void Begin(TTree* t) {wrapped->Begin(t);}
-				inline void SlaveBegin(TTree* t) {wrapped->SlaveBegin(t);}
-				inline Bool_t Notify() {return wrapped->Notify();}
-				inline Bool_t ProcessCut(Long64_t entry) {return wrapped->ProcessCut(entry);}
-				inline void ProcessFill(Long64_t entry) {wrapped->ProcessFill(entry);}
-				inline void SlaveTerminate() {wrapped->SlaveTerminate();}
-				inline void Terminate() {wrapped->Terminate();}
-				inline int Version() const {return wrapped->Version();}
-			} w(fctName.Data(), inChain);
+			PerfTimer compileTimer(phase + ".compile");
+			TSelectorWrapper w(fctName.Data(), inChain, &scheduler);
+			compileTimer.stop();
 
+			PerfTimer processTimer(phase + ".process");
 			inChain.Process(&w, option.Data(), nEntries, startEntry);
 		}
 		// add settings of last file at the end
 		if (m==mapperSpecs.size()-1)
-			Settings::global().read(inChain.GetFile());
+			Settings::current().read(inChain.GetFile());
 	}
-	Settings::global().writeToGDirectory();
+	PerfTimer writeTimer("reduce.write");
+	Settings::current().saveDefaults();
+	Settings::current().writeToGDirectory();
+	writeTimer.stop();
+	fileStats.writeToGDirectory();
+	PerfTimer closeTimer("reduce.close");
 	outFile.Write(0,TObject::kOverwrite);
 	outFile.Close();
 	cerr << "FroastTools::reduce(...) finished" << endl;
@@ -498,8 +839,6 @@ void FroastTools::reduce(const TString &inFileNames, const TString &mappers, con
 void FroastTools::tabulate(TTree *chain, std::ostream &out, const TString &varexp, const TString &selection, ssize_t nEntries, ssize_t startEntry) {
 	cerr << TString::Format("FroastTools::tabulate(TChain*, ostream, \"%s\", \"%s\")", varexp.Data(), selection.Data()) << endl;
 
-	ssize_t logEvery = GSettings::get("selector.log.every", 10000);
-
 	const TString FS_TSV = "tsv";
 	const TString FS_JSON = "json";
 	
@@ -541,6 +880,7 @@ void FroastTools::tabulate(TTree *chain, std::ostream &out, const TString &varex
 
 	const size_t ncols = functions.size();
 
+	PerfTimer compileTimer("tabulate.compile");
 	TList tformulas;
 	
 	TTreeFormula *select  = 0;
@@ -582,6 +922,7 @@ void FroastTools::tabulate(TTree *chain, std::ostream &out, const TString &varex
 			}
 		}
 	}
+	compileTimer.stop();
 
 	if (format == FS_TSV) {
 		if (!labels.empty()) {
@@ -598,23 +939,27 @@ void FroastTools::tabulate(TTree *chain, std::ostream &out, const TString &varex
 		throw invalid_argument(TString::Format("Unknown tabulation format \"%s\"", format.Data()).Data());
 	}
 	
+	PerfTimer processTimer("tabulate.process");
+	ProgressReporter progress;
+	progress.begin("Tabulating", ProgressReporter::totalEntries(chain, nEntries, startEntry));
+
 	Int_t treeNumber = -1;
 	ssize_t entry = startEntry;
 	for (; (nEntries < 0) || entry < startEntry + nEntries; ++entry) {
-		if (entry % logEvery == 0) cerr << "Tabulating entry " << entry << " [log every " << logEvery << "]" << endl;
-		
 		ssize_t entryNumber = chain->GetEntryNumber(entry);
 		if (entryNumber < 0) break;
 		ssize_t localEntry = chain->LoadTree(entryNumber);
 		if (localEntry < 0) break;
 		if (treeNumber != chain->GetTreeNumber()) {
 			cerr << "Tabulating file \"" << chain->GetTree()->GetCurrentFile()->GetName() << "\"" << endl;
+			progress.file(chain);
 			treeNumber = chain->GetTreeNumber();
 			if (manager) manager->UpdateFormulaLeaves();
 			else for (ssize_t i = 0; i <= tformulas.LastIndex(); ++i) {
 				dynamic_cast<TTreeFormula*>(tformulas.At(i))->UpdateFormulaLeaves();
 			}
 		}
+		progress.entry();
 
 		int ndata = 1;
 		if (forceDim) {
@@ -674,6 +1019,8 @@ void FroastTools::tabulate(TTree *chain, std::ostream &out, const TString &varex
 		if (entry > startEntry) out << "," << endl;
 		out << "]}" << endl;
 	}
+	progress.end();
+	processTimer.stop();
 	
 	tformulas.Clear();
 }
@@ -697,8 +1044,7 @@ TEventList* FroastTools::genEventList(TTree *tree, const TString &name, const TS
 TTree* FroastTools::filter(TTree *inputTree, const TString &outTreeName, const TString &selection, TEventList *eventList, ssize_t nEntries, ssize_t startEntry) {
 	TEventList *oldList = inputTree->GetEventList();
 	inputTree->SetEventList(eventList);
-	if (nEntries < 0) nEntries = numeric_limits<ssize_t>::max();
-	TTree* outputTree = inputTree->CopyTree(selection, "", nEntries, startEntry);
+	TTree* outputTree = copyTree(inputTree, selection, nEntries, startEntry);
 	inputTree->SetEventList(oldList);
 	return outputTree;
 }
@@ -708,6 +1054,10 @@ void FroastTools::filter(const std::list<TString> &inputs, const TString &tag, c
 	auto_ptr<TEventList> localEventList;
 	TString localSelection = selection;
 
+	// Each input file is needed once, apart from the first one, which is
+	// also used to evaluate the selection: keep only the last file open
+	FilePool inputPool(1);
+
 	if ((localSelection.Length() == 0) && ((startEntry > 0) || (nEntries > 0))) {
 		log_debug("No selection expression, but entry list and entry range specified, forcing selection expression to \"1\"");
 		localSelection = "1";
@@ -717,10 +1067,11 @@ void FroastTools::filter(const std::list<TString> &inputs, const TString &tag, c
 		if (inputs.empty()) throw invalid_argument("No input to evaluate filter expression on");
 		TString firstFileName, firstTreeName;
 		Util::splitTFileObjName(*inputs.begin(), firstFileName, firstTreeName);
-		TFile *firstFile(new TFile(firstFileName, "read"));
+		PooledFile firstFile(firstFileName, inputPool);
 		TTree *firstTree = dynamic_cast<TTree*>(firstFile->Get(firstTreeName));
 		if (firstTree == 0) throw runtime_error("Can't open input TTree");
 		log_debug("Generating event list");
+		PerfTimer selectTimer("filter.select");
 		localEventList = auto_ptr<TEventList>(FroastTools::genEventList(firstTree, "localEventList", localSelection, nEntries, startEntry));
 		if (eventList != 0) {
 			log_debug("%lli events selected", (long long)localEventList->GetN());
@@ -728,28 +1079,37 @@ void FroastTools::filter(const std::list<TString> &inputs, const TString &tag, c
 			localEventList->Intersect(eventList);
 			log_debug("%lli events remain", (long long)localEventList->GetN());
 		}
-		delete firstFile;
 	}
 	TEventList *finalEventList = (&*localEventList != 0) ? &*localEventList : eventList;
 	if (finalEventList != 0) log_info("%lli events selected", (long long)finalEventList->GetN());
 
+	// Files are processed in input order, so the first one is still open
 	typedef std::map<TString, std::list<TString> > FilesTrees;
 	FilesTrees inFilesTrees;
+	list<TString> inFileNames;
 	for (list<TString>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
 		TString fileName, treeName;
 		Util::splitTFileObjName(*it, fileName, treeName);
+		if (inFilesTrees.find(fileName) == inFilesTrees.end()) inFileNames.push_back(fileName);
 		inFilesTrees[fileName].push_back(treeName);
 	}
-	for (FilesTrees::const_iterator ft = inFilesTrees.begin(); ft != inFilesTrees.end(); ++ft) {
-		const TString &inFileName = ft->first;
-		const list<TString> &treeNames = ft->second;
+	FileScheduler scheduler;
+	for (list<TString>::const_iterator fn = inFileNames.begin(); fn != inFileNames.end(); ++fn) {
+		const TString &inFileName = *fn;
+		const list<TString> &treeNames = inFilesTrees[inFileName];
+		list<TString>::const_iterator nextFn = fn; ++nextFn;
+		if (nextFn != inFileNames.end()) scheduler.prefetch(*nextFn);
 
 		TString outFileName = (File(inFileName.Data()).base() % tag.Data()).path();
 
 		log_info("Copying input file \"%s\" to output file \"%s\"", inFileName.Data(), outFileName.Data());
 
-		auto_ptr<TFile> inputFile(new TFile(inFileName, "read"));
+		PerfStats fileStats;
+		PerfStats::Scope perfScope(fileStats);
+		PerfTimer openTimer("filter.open");
+		PooledFile inputFile(inFileName, inputPool);
 		auto_ptr<TFile> outputFile(new TFile(outFileName, "recreate"));
+		openTimer.stop();
 
 		if (finalEventList != 0) TreeEntryList(finalEventList).writeToGDirectory();
 
@@ -759,14 +1119,19 @@ void FroastTools::filter(const std::list<TString> &inputs, const TString &tag, c
 			TTree *inputTree = dynamic_cast<TTree*>(inputFile->Get(treeName));
 			if (inputTree == 0) throw runtime_error("Can't open input TTree");
 
+			PerfTimer processTimer("filter.process");
 			// Using event lists and entry ranges at the same time has weird effects
-			if (finalEventList != 0) filter(inputTree, treeName, "", finalEventList);
-			else filter(inputTree, treeName, "", 0, nEntries, startEntry);
+			TTree *outputTree = (finalEventList != 0) ?
+				filter(inputTree, treeName, "", finalEventList) :
+				filter(inputTree, treeName, "", 0, nEntries, startEntry);
+			// Unlink the copy, the input file stays open in the pool:
+			if (inputTree->GetListOfClones() != 0) inputTree->GetListOfClones()->Remove(outputTree);
 		}
 
-		outputFile->Write();
-		outputFile->Close();
+		fileStats.writeToGDirectory();
+		scheduler.close(outputFile.release(), 0, 0, "filter.close");
 	}
+	scheduler.sync();
 }
 
 } // namespace froast
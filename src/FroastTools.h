@@ -35,6 +35,9 @@
 namespace froast {
 
 
+class FileScheduler;
+
+
 class FroastTools {
 public:
 	///	@brief	Get logging level
@@ -52,6 +55,23 @@ public:
 	///	Implementation only supports trees for now
 	static void copyObject(TDirectory *tdir, const TString &objName);
 
+	///	@brief	Copy a tree into the current TDirectory
+	///
+	///	Like TTree::CloneTree(), but applies the output cluster policy (see
+	///	OutputClusters). With the "input" policy, the tree is cloned fast,
+	///	keeping the input baskets (and their compression) and clusters.
+	///	Otherwise the entries are recompressed with the output settings.
+	static TTree* cloneTree(TTree *inputTree);
+
+	///	@brief	Copy selected entries of a tree into the current TDirectory
+	///	@param	selection	Entry selection expression (as in TTree::Draw and similar)
+	///	@param	nEntries	Number of entries to be processed
+	///	@param	startEntry	First entry to be processed
+	///
+	///	Like TTree::CopyTree(), but applies the output cluster policy (see
+	///	OutputClusters). Respects the event list of the input tree.
+	static TTree* copyTree(TTree *inputTree, const TString &selection = "", Long64_t nEntries = -1, Long64_t startEntry = 0);
+
 	///	@brief	Apply selector to TChain and write results to an output file
 	///	@param	chain	Chain to which the selector should be applied
 	///	@param	selector	Name of the selector
@@ -64,7 +84,8 @@ public:
 	///	@param	mappers 		Name(s) of the selector(s) or option to draw or scan a TTree
 	///	@param	outFileName	Name of the output file
 	///	@param	noRecompile	Option to suppress forced recompilation of selector (by default a recompilation of the selector is forced)
-	static void mapSingle(const TString &inFileName, const TString &mappers, const TString &outFileName, bool noRecompile = false);
+	///	@param	scheduler	If given, the files are closed in the background via scheduler
+	static void mapSingle(const TString &inFileName, const TString &mappers, const TString &outFileName, bool noRecompile = false, FileScheduler *scheduler = 0);
 
 	///	@brief	Apply mapper (selector or other option) to TTrees in several files and write results to an output file
 	///	@param	fileName	Name of the input ROOT file
@@ -78,6 +99,13 @@ public:
 	///	@param	mappers	Name(s) of the selector(s) or option to draw or scan a TTree
 	///	@param	outFileName	Name of the output file
 	///	@param	noRecompile	Option to suppress forced recompilation of selector (by default a recompilation of the selector is forced)
+	///
+	///	With "froast.reduce.threads" (default: 1) above 1, a single compiled
+	///	selector without entry range is run in several threads, each one on
+	///	a consecutive part of the input files, writing through an
+	///	OutputMerger (ROOT 6.10 and above). Output trees then hold the
+	///	entries of each part as a block, in no particular order of the
+	///	parts. Other mappers run sequentially.
 	static void reduce(const TString &inFileNames, const TString &mappers, const TString &outFileName, bool noRecompile = false);
 
 	// JSON output format
@@ -0,0 +1,147 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "InputCache.h"
+
+#include <algorithm>
+
+#include <TEnv.h>
+#include <TFile.h>
+#include <TBranch.h>
+#include <TTreeCache.h>
+
+#include "logging.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+// Looked up for every input file
+Setting<int32_t> s_cacheSize("froast.input.ttree.cache", -1);
+Setting<double> s_cacheClusters("froast.input.ttree.cache.clusters", 2.0);
+Setting<double> s_cacheMin("froast.input.ttree.cache.min", 1024 * 1024);
+Setting<double> s_cacheMax("froast.input.ttree.cache.max", 256 * 1024 * 1024);
+
+} // namespace
+
+
+InputCache::Config::Config()
+	: size(s_cacheSize), clusters(s_cacheClusters), minSize(s_cacheMin), maxSize(s_cacheMax)
+{}
+
+
+void InputCache::configure() {
+	// Set in gEnv directly below the local level, so the stored settings
+	// of output files and the settings layers don't see it
+	if (Settings::global()("froast.input.ttree.cache.async", false, false) && !gEnv->Defined("TFile.AsyncPrefetching"))
+		gEnv->SetValue("TFile.AsyncPrefetching", "1", kEnvGlobal);
+}
+
+
+void InputCache::prepare(TTree *tree, const Config &config) {
+	// Negative size lets ROOT choose an initial size, adapt() will resize
+	tree->SetCacheSize(config.size);
+}
+
+
+Long64_t InputCache::adapt(TTree *tree, Int_t learnEntries, const Config &config) {
+	if (learnEntries > 0) tree->SetCacheLearnEntries(learnEntries);
+
+	Long64_t cacheSize = config.size;
+	if (cacheSize >= 0) {
+		tree->SetCacheSize(cacheSize);
+		return cacheSize;
+	}
+
+	TTree *current = tree->GetTree();
+	if ((current == 0) || (current->GetEntries() <= 0)) return tree->GetCacheSize();
+	Long64_t nEntries = current->GetEntries();
+
+	Long64_t clusterEntries = current->GetAutoFlush();
+	if (clusterEntries <= 0) {
+		TTree::TClusterIterator clusters = current->GetClusterIterator(0);
+		clusters.Next();
+		clusterEntries = clusters.GetNextEntry() - clusters.GetStartEntry();
+	}
+	clusterEntries = std::min(std::max(clusterEntries, Long64_t(1)), nEntries);
+
+	double zipBytes = 0;
+	TObjArray *branches = current->GetListOfBranches();
+	for (Int_t i = 0; i < branches->GetEntriesFast(); ++i) {
+		TBranch *branch = dynamic_cast<TBranch*>(branches->At(i));
+		if ((branch != 0) && current->GetBranchStatus(branch->GetName()))
+			zipBytes += double(branch->GetZipBytes("*"));
+	}
+
+	double size = zipBytes / double(nEntries) * double(clusterEntries) * config.clusters;
+	cacheSize = Long64_t(std::max(config.minSize, std::min(config.maxSize, size)));
+
+	tree->SetCacheSize(cacheSize);
+	log_debug("Input cache: %lli bytes for %lli entries per cluster (%.1f compressed bytes per entry)",
+		(long long)cacheSize, (long long)clusterEntries, zipBytes / double(nEntries));
+	return cacheSize;
+}
+
+
+void InputCache::fileBegin(TTree *tree) {
+	TTree *current = tree->GetTree();
+	TFile *file = (current != 0) ? current->GetCurrentFile() : 0;
+	m_fileName = (file != 0) ? file->GetName() : "";
+	m_bytesRead = TFile::GetFileBytesRead();
+	m_readCalls = TFile::GetFileReadCalls();
+}
+
+
+void InputCache::fileEnd(TTree *tree) {
+	if (m_fileName.Length() == 0) return;
+
+	Long64_t bytesRead = TFile::GetFileBytesRead() - m_bytesRead;
+	Int_t readCalls = TFile::GetFileReadCalls() - m_readCalls;
+
+	TTree *current = tree->GetTree();
+	TFile *file = (current != 0) ? current->GetCurrentFile() : 0;
+	// After a TChain switched files, the cache of the previous file is gone:
+	bool sameFile = (file != 0) && (m_fileName == file->GetName());
+	TTreeCache *cache = sameFile ? dynamic_cast<TTreeCache*>(file->GetCacheRead(current)) : 0;
+
+	if (cache != 0) {
+		log_info("Input cache statistics for \"%s\": hit ratio %.3f (relative %.3f), %i read calls, %lli bytes read",
+			m_fileName.Data(), cache->GetEfficiency(), cache->GetEfficiencyRel(), readCalls, (long long)bytesRead);
+	} else {
+		log_info("Input statistics for \"%s\": %i read calls, %lli bytes read",
+			m_fileName.Data(), readCalls, (long long)bytesRead);
+	}
+	m_fileName = "";
+}
+
+
+InputCache::InputCache()
+	: m_bytesRead(0), m_readCalls(0)
+{}
+
+
+InputCache::~InputCache() {}
+
+
+} // namespace froast
@@ -0,0 +1,96 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_INPUTCACHE_H
+#define FROAST_INPUTCACHE_H
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TTree.h>
+
+
+namespace froast {
+
+
+///	@brief	Adaptive TTreeCache setup and per-file cache statistics
+///
+///	Settings:
+///	- "froast.input.ttree.cache": Cache size in bytes, -1 (default) for
+///	  adaptive sizing, 0 to disable the cache
+///	- "froast.input.ttree.cache.clusters": Number of clusters of the enabled
+///	  branches the adaptive cache should hold (default: 2)
+///	- "froast.input.ttree.cache.min", "froast.input.ttree.cache.max":
+///	  Limits for the adaptive cache size in bytes
+///	- "froast.input.ttree.cache.async": Use ROOT's (experimental)
+///	  asynchronous prefetching in a background thread (default: false),
+///	  see configure()
+
+class InputCache {
+protected:
+	TString m_fileName;
+	Long64_t m_bytesRead;
+	Int_t m_readCalls;
+
+public:
+	///	@brief	Cache settings, read from the current settings context
+	///
+	///	Read on the thread that owns the context, to set up caches in
+	///	other threads.
+	struct Config {
+		Long64_t size;
+		double clusters;
+		double minSize;
+		double maxSize;
+
+		Config();
+	};
+
+	///	@brief	Apply process-wide settings, before any input file is opened
+	///
+	///	Enables TFile.AsyncPrefetching in gEnv if requested, unless it is
+	///	set already.
+	static void configure();
+
+	///	@brief	Set up the cache of a tree, before branches are enabled and added
+	static void prepare(TTree *tree, const Config &config = Config());
+
+	///	@brief	Size the cache according to the enabled branches and the cluster size
+	///	@param	tree	Tree or chain (the current tree of a chain is used)
+	///	@param	learnEntries	Number of entries for the TTreeCache learning phase, -1 for ROOT's default
+	///	@return	New cache size
+	static Long64_t adapt(TTree *tree, Int_t learnEntries = -1, const Config &config = Config());
+
+	///	@brief	Start collecting statistics for the current file of a tree
+	void fileBegin(TTree *tree);
+
+	///	@brief	Log cache statistics for the file since fileBegin()
+	///
+	///	Call before a TChain switches to the next file, afterwards only the
+	///	read statistics are available, not those of the cache. Does nothing
+	///	if already called since fileBegin().
+	void fileEnd(TTree *tree);
+
+	InputCache();
+	virtual ~InputCache();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_INPUTCACHE_H
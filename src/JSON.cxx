@@ -18,10 +18,9 @@
 #include "JSON.h"
 
 
-#include <iomanip>
-#include <limits>
-#include <sstream>
+#include <vector>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <stdint.h>
 
@@ -32,7 +31,6 @@
 #include <TObjString.h>
 #include <TParameter.h>
 
-#include "vjson.h"
 
 
 using namespace std;
@@ -43,109 +41,52 @@ namespace {
 
 using namespace froast;
 
-TObject* importJSON(json_value* value) {
-	switch(value->type) {
-		case JSON_NULL: {
-			return 0;
-		}
-		case JSON_OBJECT: {
-			THashList *list = new THashList;
-			for (json_value *it = value->first_child; it; it = it->next_sibling) {
-				assert (it->name);
-				list->AddLast(new TPair(new TObjString(it->name), importJSON(it)));
-			}
-			return list;
-		}
-		case JSON_ARRAY: {
-			TList *list = new TList;
-			for (json_value *it = value->first_child; it; it = it->next_sibling) {
-				assert (!it->name);
-				list->AddLast(importJSON(it));
-			}
-			return list;
-		}
-		case JSON_STRING: {
-			return new TObjString(value->string_value);
-		}
-		case JSON_INT: {
-			return new TParameter<int32_t>("", value->int_value);
-		}
-		case JSON_FLOAT: {
-			return new TParameter<double>("", value->float_value);
-		}
-		case JSON_BOOL: {
-			return new TObjString(value->int_value ? "true" : "false");
-		}
-		default: assert(false);
-	}
-}
-
-
-void exportJSON(ostream &json, const TObject* value) {
-	if (value == 0) json << "null";
-	else {
+void exportJSON(JSONWriter &json, const TObject* value) {
+	// Scalars first, they are by far the most frequent values
+	if (value == 0) {
+		json.nullValue();
+	} else if (const TObjString* stringValue = dynamic_cast<const TObjString*>(value)) {
+		const TString &s = stringValue->GetString();
+		if (s == "true") json.boolValue(true);
+		else if (s == "false") json.boolValue(false);
+		else json.stringValue(s.Data(), s.Length());
+	} else if (const TParameter<double>* param = dynamic_cast<const TParameter<double>*>(value)) {
+		json.floatValue(param->GetVal());
+	} else if (const TParameter<int32_t>* param = dynamic_cast<const TParameter<int32_t>*>(value)) {
+		json.intValue(param->GetVal());
+	} else if (const TParameter<int64_t>* param = dynamic_cast<const TParameter<int64_t>*>(value)) {
+		json.intValue(param->GetVal());
+	} else if (const TParameter<float>* param = dynamic_cast<const TParameter<float>*>(value)) {
+		json.floatValue(param->GetVal());
+	} else if (const TCollection* collection = dynamic_cast<const TCollection*>(value)) {
 		if (
-			dynamic_cast<const THashList*>(value)
-			|| dynamic_cast<const THashTable*>(value)
+			dynamic_cast<const THashList*>(collection)
+			|| dynamic_cast<const THashTable*>(collection)
 		) {
-			const TCollection* objectValue = dynamic_cast<const TCollection*>(value);
-			int counter = 0;
-			json << "{";
-			TIter next(objectValue, kIterForward);
+			json.beginObject();
+			TIter next(collection, kIterForward);
 			const TPair *member;
 			while ( (member = dynamic_cast<const TPair*>(next())) ) {
-				if (counter > 0) json << ", ";
-				assert(dynamic_cast<const TObjString*>(member->Key()));
-				exportJSON(json, member->Key());
-				json << ": ";
+				const TObjString *key = dynamic_cast<const TObjString*>(member->Key());
+				assert(key != 0);
+				json.key(key->GetString().Data(), key->GetString().Length());
 				exportJSON(json, member->Value());
-				++counter;
 			}
-			json << "}";
-		} else if (dynamic_cast<const TMap*>(value)) {
-			const TMap* map = dynamic_cast<const TMap*>(value);
+			json.endObject();
+		} else if (const TMap* map = dynamic_cast<const TMap*>(collection)) {
 			exportJSON(json, map->GetTable());
 		} else if (
-			dynamic_cast<const TList*>(value)
-			|| dynamic_cast<const TObjArray*>(value)
-			|| dynamic_cast<const TOrdCollection*>(value)
+			dynamic_cast<const TList*>(collection)
+			|| dynamic_cast<const TObjArray*>(collection)
+			|| dynamic_cast<const TOrdCollection*>(collection)
 		) {
-			const TCollection* arrayValue = dynamic_cast<const TCollection*>(value);
-			int counter = 0;
-			json << "[";
-			TIter next(arrayValue, kIterForward);
+			json.beginArray();
+			TIter next(collection, kIterForward);
 			TObject *member;
-			while ( (member = next()) ) {
-				if (counter > 0) json << ", ";
-				exportJSON(json, member);
-				++counter;
-			}
-			json << "]";
-		} else if (dynamic_cast<const TObjString*>(value)) {
-			const TObjString* stringValue = dynamic_cast<const TObjString*>(value);
-			TString s = stringValue->GetString();
-			if ((s == "true") || (s == "false")) json << s;
-			else json << "\"" << s << "\"";
-		} else if (dynamic_cast<const TParameter<int32_t>*>(value)) {
-			const TParameter<int32_t>* param = dynamic_cast<const TParameter<int32_t>*>(value);
-			int32_t x = param->GetVal();
-			json << x;
-		} else if (dynamic_cast<const TParameter<int64_t>*>(value)) {
-			const TParameter<int64_t>* param = dynamic_cast<const TParameter<int64_t>*>(value);
-			int64_t x = param->GetVal();
-			json << x;
-		} else if (dynamic_cast<const TParameter<float>*>(value)) {
-			const TParameter<float>* param = dynamic_cast<const TParameter<float>*>(value);
-			float x = param->GetVal();
-			if (x == int32_t(x)) json << int32_t(x) << ".";
-			else json << x;
-		} else if (dynamic_cast<const TParameter<double>*>(value)) {
-			const TParameter<double>* param = dynamic_cast<const TParameter<double>*>(value);
-			double x = param->GetVal();
-			if (x == int64_t(x)) json << int64_t(x) << ".";
-			else json << x;
+			while ( (member = next()) ) exportJSON(json, member);
+			json.endArray();
 		} else assert(false);
-	}
+	} else assert(false);
 }
 
 
@@ -156,43 +97,159 @@ void exportJSON(ostream &json, const TObject* value) {
 namespace froast {
 
 
-THashList* JSON::read(const char* json) {
-	char *src = ::strdup(json);
-	char *errorPos = 0;
-	char *errorDesc = 0;
-	int errorLine = 0;
-	block_allocator allocator(1 << 10); // 1 KB per block
-
-	json_value *root = json_parse(src, &errorPos, &errorDesc, &errorLine, &allocator);
+void JSONObjectBuilder::add(TObject *value) {
+	if (m_stack.empty()) {
+		assert(m_result == 0);
+		m_result = value;
+	} else if (m_isObject.back()) {
+		m_stack.back()->AddLast(new TPair(new TObjString(m_key), value));
+	} else {
+		m_stack.back()->AddLast(value);
+	}
+}
 
-	THashList *result = dynamic_cast<THashList*>(importJSON(root));
 
-	::free(src);
+TObject* JSONObjectBuilder::release() {
+	TObject *result = m_result;
+	m_result = 0;
 	return result;
 }
 
+
+void JSONObjectBuilder::beginObject() {
+	THashList *list = new THashList;
+	add(list);
+	m_stack.push_back(list);
+	m_isObject.push_back(true);
+}
+
+void JSONObjectBuilder::endObject() { m_stack.pop_back(); m_isObject.pop_back(); }
+
+
+void JSONObjectBuilder::beginArray() {
+	TList *list = new TList;
+	add(list);
+	m_stack.push_back(list);
+	m_isObject.push_back(false);
+}
+
+void JSONObjectBuilder::endArray() { m_stack.pop_back(); m_isObject.pop_back(); }
+
+
+void JSONObjectBuilder::key(const char *name, size_t length) { m_key = TString(name, length); }
+
+void JSONObjectBuilder::stringValue(const char *value, size_t length)
+	{ add(new TObjString(TString(value, length))); }
+
+void JSONObjectBuilder::intValue(int64_t value) {
+	if (value == int64_t(int32_t(value))) add(new TParameter<int32_t>("", int32_t(value)));
+	else add(new TParameter<int64_t>("", value));
+}
+
+void JSONObjectBuilder::floatValue(double value) { add(new TParameter<double>("", value)); }
+
+void JSONObjectBuilder::boolValue(bool value) { add(new TObjString(value ? "true" : "false")); }
+
+void JSONObjectBuilder::nullValue() { add(0); }
+
+
+JSONObjectBuilder::JSONObjectBuilder(): m_result(0) {}
+
+JSONObjectBuilder::~JSONObjectBuilder() {
+	// Only non-zero if parsing failed or the result was never released
+	JSON::deleteTree(m_result);
+}
+
+
+
+THashList* JSON::read(const char* json) {
+	JSONObjectBuilder builder;
+	parse(json, strlen(json), builder);
+	TObject *result = builder.release();
+	THashList *list = dynamic_cast<THashList*>(result);
+	if (list == 0) deleteTree(result);
+	return list;
+}
+
 THashList* JSON::read(std::istream &json) {
-	stringstream in;
-	in << json.rdbuf();
-	return read(in.str().c_str());
+	JSONObjectBuilder builder;
+	parse(json, builder);
+	TObject *result = builder.release();
+	THashList *list = dynamic_cast<THashList*>(result);
+	if (list == 0) deleteTree(result);
+	return list;
 }
 
 THashList* JSON::read(const std::string &json) { return read(json.c_str()); }
 THashList* JSON::read(const TString &json) { return read(json.Data()); }
 
 
+void JSON::parse(const char* json, size_t length, JSONHandler &handler) {
+	JSONParser parser;
+	parser.parse(json, length, handler);
+}
+
+
+void JSON::parse(std::istream &json, JSONHandler &handler) {
+	// Read into a private buffer, which can then be parsed in place
+	vector<char> buffer;
+	char chunk[65536];
+	while (json.read(chunk, sizeof(chunk)) || json.gcount() > 0)
+		buffer.insert(buffer.end(), chunk, chunk + json.gcount());
+	JSONParser parser;
+	if (buffer.empty()) parser.parse("", 0, handler);
+	else parser.parseInSitu(&buffer[0], buffer.size(), handler);
+}
+
+
+void JSON::deleteTree(TObject *value) {
+	if (value == 0) return;
+	if (dynamic_cast<TPair*>(value)) {
+		TPair *pair = dynamic_cast<TPair*>(value);
+		deleteTree(pair->Key());
+		deleteTree(pair->Value());
+	} else if (dynamic_cast<TCollection*>(value)) {
+		// Detach members first, the collection must not see them after deletion
+		TCollection *collection = dynamic_cast<TCollection*>(value);
+		vector<TObject*> members;
+		TIter next(collection, kIterForward);
+		TObject *member;
+		while ( (member = next()) ) members.push_back(member);
+		collection->Clear("nodelete");
+		for (size_t i = 0; i < members.size(); ++i) deleteTree(members[i]);
+	}
+	delete value;
+}
+
+
 std::string JSON::toString(const TObject* list) {
-	stringstream json;
-	write(json, list);
+	JSONWriter json;
+	exportJSON(json, list);
 	return json.str();
 }
 
 
-std::ostream& JSON::write(std::ostream &json, const TObject* list) {
-	json.unsetf(ios::fixed | ios::scientific);
-	json << std::setprecision(std::numeric_limits<double>::digits10);
+std::string JSON::numberToString(double x) {
+	char buffer[JSONWriter::max_number_length];
+	return std::string(buffer, JSONWriter::formatFloat(buffer, x));
+}
+
+
+std::string JSON::numberToString(int64_t x) {
+	char buffer[JSONWriter::max_number_length];
+	return std::string(buffer, JSONWriter::formatInt(buffer, x));
+}
+
+
+void JSON::write(JSONWriter &json, const TObject* list) {
 	exportJSON(json, list);
-	return json;
+}
+
+
+std::ostream& JSON::write(std::ostream &json, const TObject* list) {
+	JSONWriter writer;
+	exportJSON(writer, list);
+	return writer.writeTo(json);
 }
 
 
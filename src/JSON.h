@@ -19,16 +19,54 @@
 #define FROAST_JSON_H
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 #include <THashList.h>
 #include <TString.h>
 #include <TParameter.h>
 
+#include "JSONParser.h"
+#include "JSONWriter.h"
+
 
 namespace froast {
 
 
+///	@brief	Builds ROOT objects from JSON events
+///
+///	Objects become THashLists of TPairs with TObjString keys, arrays
+///	TLists, strings and booleans TObjStrings, numbers TParameter<int32_t>
+///	(TParameter<int64_t> if out of range) or TParameter<double>, null 0.
+class JSONObjectBuilder: public JSONHandler {
+protected:
+	std::vector<TList*> m_stack;
+	std::vector<bool> m_isObject;
+	TString m_key;
+	TObject *m_result;
+
+	void add(TObject *value);
+
+public:
+	///	@brief	Get the value built, ownership passes to the caller
+	TObject* release();
+
+	virtual void beginObject();
+	virtual void endObject();
+	virtual void beginArray();
+	virtual void endArray();
+	virtual void key(const char *name, size_t length);
+	virtual void stringValue(const char *value, size_t length);
+	virtual void intValue(int64_t value);
+	virtual void floatValue(double value);
+	virtual void boolValue(bool value);
+	virtual void nullValue();
+
+	JSONObjectBuilder();
+	virtual ~JSONObjectBuilder();
+};
+
+
 class JSON {
 public:
 	static THashList* read(const char* json);
@@ -36,9 +74,21 @@ public:
 	static THashList* read(const std::string &json);
 	static THashList* read(const TString &json);
 
+	///	@brief	Parse JSON and pass its contents to a handler, without building ROOT objects
+	static void parse(const char* json, size_t length, JSONHandler &handler);
+	static void parse(std::istream &json, JSONHandler &handler);
+
+	///	@brief	Delete a value returned by read(), including all its members
+	static void deleteTree(TObject *value);
+
 	static std::string toString(const TObject* list);
 
+	///	@brief	JSON representation of a number, as written by write()
+	static std::string numberToString(double x);
+	static std::string numberToString(int64_t x);
+
 	static std::ostream& write(std::ostream &json, const TObject* list);
+	static void write(JSONWriter &json, const TObject* list);
 };
 
 
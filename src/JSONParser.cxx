@@ -0,0 +1,534 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "JSONParser.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "block_allocator.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+const int maxDepth = 1024;
+
+// Character classification bit masks of a 64 byte block
+struct BlockMasks {
+	uint64_t structural;
+	uint64_t whitespace;
+	uint64_t quote;
+	uint64_t backslash;
+};
+
+
+#ifdef __SSE2__
+
+inline uint64_t movemask64(const __m128i *v) {
+	return uint64_t(uint32_t(_mm_movemask_epi8(v[0])))
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v[1]))) << 16)
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v[2]))) << 32)
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v[3]))) << 48);
+}
+
+inline __m128i eq(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+void classify(const char *block, BlockMasks &masks) {
+	__m128i structural[4], whitespace[4], quote[4], backslash[4];
+	for (int i = 0; i < 4; ++i) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+		// '[' and ']' differ from '{' and '}' in bit 5 only
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		structural[i] = _mm_or_si128(_mm_or_si128(eq(lower, '{'), eq(lower, '}')), _mm_or_si128(eq(v, ','), eq(v, ':')));
+		whitespace[i] = _mm_or_si128(_mm_or_si128(eq(v, ' '), eq(v, '\t')), _mm_or_si128(eq(v, '\n'), eq(v, '\r')));
+		quote[i] = eq(v, '"');
+		backslash[i] = eq(v, '\\');
+	}
+	masks.structural = movemask64(structural);
+	masks.whitespace = movemask64(whitespace);
+	masks.quote = movemask64(quote);
+	masks.backslash = movemask64(backslash);
+}
+
+// First '"' or '\\' at or after p
+inline const char* findQuoteOrEscape(const char *p, const char *end) {
+	while (p + 16 <= end) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		int found = _mm_movemask_epi8(_mm_or_si128(eq(v, '"'), eq(v, '\\')));
+		if (found != 0) return p + __builtin_ctz(found);
+		p += 16;
+	}
+	while ((p < end) && (*p != '"') && (*p != '\\')) ++p;
+	return p;
+}
+
+#else
+
+enum CharClass { CC_OTHER = 0, CC_STRUCTURAL, CC_WHITESPACE, CC_QUOTE, CC_BACKSLASH };
+
+struct CharClasses {
+	unsigned char table[256];
+	CharClasses() {
+		memset(table, CC_OTHER, sizeof(table));
+		table['{'] = table['}'] = table['['] = table[']'] = table[','] = table[':'] = CC_STRUCTURAL;
+		table[' '] = table['\t'] = table['\n'] = table['\r'] = CC_WHITESPACE;
+		table['"'] = CC_QUOTE;
+		table['\\'] = CC_BACKSLASH;
+	}
+};
+
+const CharClasses charClasses;
+
+void classify(const char *block, BlockMasks &masks) {
+	masks.structural = masks.whitespace = masks.quote = masks.backslash = 0;
+	for (int i = 0; i < 64; ++i) {
+		uint64_t bit = uint64_t(1) << i;
+		switch (charClasses.table[(unsigned char)block[i]]) {
+			case CC_STRUCTURAL: masks.structural |= bit; break;
+			case CC_WHITESPACE: masks.whitespace |= bit; break;
+			case CC_QUOTE: masks.quote |= bit; break;
+			case CC_BACKSLASH: masks.backslash |= bit; break;
+			default: break;
+		}
+	}
+}
+
+inline const char* findQuoteOrEscape(const char *p, const char *end) {
+	while ((p < end) && (*p != '"') && (*p != '\\')) ++p;
+	return p;
+}
+
+#endif
+
+
+// Bit i of the result is the XOR of bits 0 to i of x
+inline uint64_t prefixXor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+
+inline bool isDelimiter(char c) {
+	switch (c) {
+		case ' ': case '\t': case '\n': case '\r':
+		case ',': case ':': case '[': case ']': case '{': case '}':
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+inline int hexDigit(char c) {
+	if ((c >= '0') && (c <= '9')) return c - '0';
+	if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+	return -1;
+}
+
+
+char* writeUTF8(char *dst, uint32_t cp) {
+	if (cp < 0x80) {
+		*dst++ = char(cp);
+	} else if (cp < 0x800) {
+		*dst++ = char(0xC0 | (cp >> 6));
+		*dst++ = char(0x80 | (cp & 0x3F));
+	} else if (cp < 0x10000) {
+		*dst++ = char(0xE0 | (cp >> 12));
+		*dst++ = char(0x80 | ((cp >> 6) & 0x3F));
+		*dst++ = char(0x80 | (cp & 0x3F));
+	} else {
+		*dst++ = char(0xF0 | (cp >> 18));
+		*dst++ = char(0x80 | ((cp >> 12) & 0x3F));
+		*dst++ = char(0x80 | ((cp >> 6) & 0x3F));
+		*dst++ = char(0x80 | (cp & 0x3F));
+	}
+	return dst;
+}
+
+
+// Powers of ten that are exactly representable as double
+const double exactPowersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const uint64_t maxExactMantissa = uint64_t(1) << 53;
+
+} // namespace
+
+
+void JSONParser::fail(size_t pos, const char *desc) const {
+	int line = 1;
+	for (size_t i = 0; (i < pos) && (i < m_size); ++i) if (m_data[i] == '\n') ++line;
+	char msg[256];
+	snprintf(msg, sizeof(msg), "JSON syntax error in line %i: %s", line, desc);
+	throw runtime_error(msg);
+}
+
+
+void JSONParser::buildIndex() {
+	m_index.clear();
+	m_index.reserve(m_size / 4 + 16);
+
+	uint64_t prevInString = 0; // all bits set if the previous block ended within a string
+	uint64_t prevScalar = 0; // 1 if the previous block ended with a scalar character
+	bool prevEscape = false; // previous block ended with an unescaped backslash
+	char padded[64];
+
+	for (size_t base = 0; base < m_size; base += 64) {
+		const char *block = m_data + base;
+		if (m_size - base < 64) {
+			memset(padded, ' ', sizeof(padded));
+			memcpy(padded, block, m_size - base);
+			block = padded;
+		}
+
+		BlockMasks masks;
+		classify(block, masks);
+
+		// Characters following an odd number of backslashes are escaped,
+		// rare enough to resolve bit by bit
+		uint64_t escaped = 0;
+		if ((masks.backslash != 0) || prevEscape) {
+			for (int i = 0; i < 64; ++i) {
+				uint64_t bit = uint64_t(1) << i;
+				if (prevEscape) { escaped |= bit; prevEscape = false; }
+				else if (masks.backslash & bit) prevEscape = true;
+			}
+		}
+
+		uint64_t quotes = masks.quote & ~escaped;
+		// Set from each opening quote up to (excluding) the closing quote:
+		uint64_t inString = prefixXor(quotes) ^ prevInString;
+		prevInString = uint64_t(int64_t(inString) >> 63);
+
+		uint64_t structural = masks.structural & ~inString;
+		uint64_t openingQuotes = quotes & inString;
+		uint64_t scalar = ~(masks.structural | masks.whitespace | quotes | inString);
+		uint64_t scalarStarts = scalar & ~((scalar << 1) | prevScalar);
+		prevScalar = scalar >> 63;
+
+		uint64_t bits = structural | openingQuotes | scalarStarts;
+		while (bits != 0) {
+			m_index.push_back(uint32_t(base + __builtin_ctzll(bits)));
+			bits &= bits - 1;
+		}
+	}
+
+	if (prevInString != 0) fail(m_size, "Unterminated string");
+}
+
+
+size_t JSONParser::nextIndex() {
+	if (m_next >= m_index.size()) fail(m_size, "Unexpected end of input");
+	return m_index[m_next++];
+}
+
+
+char JSONParser::peek() const {
+	return (m_next < m_index.size()) ? m_data[m_index[m_next]] : '\0';
+}
+
+
+void JSONParser::parseValue(JSONHandler &handler) {
+	size_t pos = nextIndex();
+	switch (m_data[pos]) {
+		case '{': parseObject(handler); break;
+		case '[': parseArray(handler); break;
+		case '"': {
+			size_t length = parseString(pos);
+			handler.stringValue(m_data + pos + 1, length);
+			break;
+		}
+		case 't': case 'f': case 'n':
+			parseLiteral(pos, handler);
+			break;
+		case '-': case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			parseNumber(pos, handler);
+			break;
+		default:
+			fail(pos, "Unexpected character");
+	}
+}
+
+
+void JSONParser::parseObject(JSONHandler &handler) {
+	if (++m_depth > maxDepth) fail(m_index[m_next - 1], "Nesting too deep");
+	handler.beginObject();
+	if (peek() == '}') {
+		nextIndex();
+	} else while (true) {
+		size_t pos = nextIndex();
+		if (m_data[pos] != '"') fail(pos, "Expected member name");
+		size_t length = parseString(pos);
+		handler.key(m_data + pos + 1, length);
+
+		pos = nextIndex();
+		if (m_data[pos] != ':') fail(pos, "Expected ':'");
+		parseValue(handler);
+
+		pos = nextIndex();
+		if (m_data[pos] == '}') break;
+		else if (m_data[pos] != ',') fail(pos, "Expected ',' or '}'");
+	}
+	handler.endObject();
+	--m_depth;
+}
+
+
+void JSONParser::parseArray(JSONHandler &handler) {
+	if (++m_depth > maxDepth) fail(m_index[m_next - 1], "Nesting too deep");
+	handler.beginArray();
+	if (peek() == ']') {
+		nextIndex();
+	} else while (true) {
+		parseValue(handler);
+		size_t pos = nextIndex();
+		if (m_data[pos] == ']') break;
+		else if (m_data[pos] != ',') fail(pos, "Expected ',' or ']'");
+	}
+	handler.endArray();
+	--m_depth;
+}
+
+
+size_t JSONParser::parseString(size_t pos) {
+	char *const begin = m_data + pos + 1;
+	const char *end = m_data + m_size;
+	const char *src = begin;
+	char *dst = begin;
+
+	while (true) {
+		const char *next = findQuoteOrEscape(src, end);
+		if (dst != src) memmove(dst, src, next - src);
+		dst += next - src;
+		src = next;
+		if (src >= end) fail(pos, "Unterminated string");
+		if (*src == '"') break;
+
+		// Escape sequence
+		if (++src >= end) fail(pos, "Unterminated string");
+		switch (*src++) {
+			case '"': *dst++ = '"'; break;
+			case '\\': *dst++ = '\\'; break;
+			case '/': *dst++ = '/'; break;
+			case 'b': *dst++ = '\b'; break;
+			case 'f': *dst++ = '\f'; break;
+			case 'n': *dst++ = '\n'; break;
+			case 'r': *dst++ = '\r'; break;
+			case 't': *dst++ = '\t'; break;
+			case 'u': {
+				uint32_t cp = 0;
+				for (int i = 0; i < 4; ++i, ++src) {
+					int d = (src < end) ? hexDigit(*src) : -1;
+					if (d < 0) fail(pos, "Invalid unicode escape");
+					cp = (cp << 4) | uint32_t(d);
+				}
+				// Surrogate pair
+				if ((cp >= 0xD800) && (cp <= 0xDBFF) && (src + 6 <= end) && (src[0] == '\\') && (src[1] == 'u')) {
+					uint32_t low = 0;
+					bool valid = true;
+					for (int i = 2; i < 6; ++i) {
+						int d = hexDigit(src[i]);
+						if (d < 0) { valid = false; break; }
+						low = (low << 4) | uint32_t(d);
+					}
+					if (valid && (low >= 0xDC00) && (low <= 0xDFFF)) {
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						src += 6;
+					}
+				}
+				dst = writeUTF8(dst, cp);
+				break;
+			}
+			default:
+				fail(pos, "Invalid escape sequence");
+		}
+	}
+
+	*dst = '\0';
+	return size_t(dst - begin);
+}
+
+
+void JSONParser::parseLiteral(size_t pos, JSONHandler &handler) {
+	const char *p = m_data + pos;
+	size_t avail = m_size - pos;
+	size_t length = 0;
+	if ((avail >= 4) && (memcmp(p, "true", 4) == 0)) length = 4;
+	else if ((avail >= 5) && (memcmp(p, "false", 5) == 0)) length = 5;
+	else if ((avail >= 4) && (memcmp(p, "null", 4) == 0)) length = 4;
+	if ((length == 0) || ((length < avail) && !isDelimiter(p[length]))) fail(pos, "Invalid literal");
+
+	if (p[0] == 'n') handler.nullValue();
+	else handler.boolValue(p[0] == 't');
+}
+
+
+void JSONParser::parseNumber(size_t pos, JSONHandler &handler) {
+	const char *const begin = m_data + pos;
+	const char *const end = m_data + m_size;
+	const char *p = begin;
+
+	bool negative = (*p == '-');
+	if (negative) ++p;
+	if ((p >= end) || (*p < '0') || (*p > '9')) fail(pos, "Invalid number");
+	if ((*p == '0') && (p + 1 < end) && (p[1] >= '0') && (p[1] <= '9')) fail(pos, "Invalid number (leading zero)");
+
+	uint64_t mantissa = 0;
+	int significant = 0; // significant digits in mantissa
+	bool truncated = false;
+	int exp10 = 0;
+
+	for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p) {
+		int d = *p - '0';
+		if ((mantissa == 0) && (d == 0)) continue;
+		if (significant < 19) { mantissa = mantissa * 10 + d; ++significant; }
+		else { truncated = true; ++exp10; }
+	}
+
+	bool isFloat = false;
+	if ((p < end) && (*p == '.')) {
+		isFloat = true;
+		++p;
+		// Digits after the decimal point are optional here, older versions
+		// of JSON::write wrote integral floating point values as "N."
+		for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p) {
+			int d = *p - '0';
+			if ((mantissa == 0) && (d == 0)) { --exp10; continue; }
+			if (significant < 19) { mantissa = mantissa * 10 + d; ++significant; --exp10; }
+			else truncated = true;
+		}
+	}
+
+	if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+		isFloat = true;
+		++p;
+		bool negativeExp = false;
+		if ((p < end) && ((*p == '+') || (*p == '-'))) { negativeExp = (*p == '-'); ++p; }
+		if ((p >= end) || (*p < '0') || (*p > '9')) fail(pos, "Invalid number (no digits in exponent)");
+		int e = 0;
+		for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p) if (e < 100000) e = e * 10 + (*p - '0');
+		exp10 += negativeExp ? -e : e;
+	}
+
+	if ((p < end) && !isDelimiter(*p)) fail(pos, "Invalid number");
+
+	if (!isFloat && !truncated) {
+		const uint64_t limit = uint64_t(numeric_limits<int64_t>::max()) + (negative ? 1 : 0);
+		if (mantissa <= limit) {
+			handler.intValue(negative ? int64_t(0 - mantissa) : int64_t(mantissa));
+			return;
+		}
+	}
+
+	// Clinger's fast path: mantissa and power of ten are both exact doubles,
+	// so a single multiplication or division is correctly rounded
+	if (!truncated && (mantissa <= maxExactMantissa)) {
+		double value = 0;
+		bool exact = true;
+		if (mantissa == 0) value = 0;
+		else if ((exp10 >= -22) && (exp10 <= 22)) {
+			value = (exp10 < 0) ? double(mantissa) / exactPowersOf10[-exp10] : double(mantissa) * exactPowersOf10[exp10];
+		} else if ((exp10 > 22) && (exp10 <= 22 + 15)) {
+			// Move part of the exponent into the mantissa, if it stays exact
+			uint64_t m = mantissa;
+			for (int i = 22; (i < exp10) && exact; ++i) {
+				m *= 10;
+				if (m > maxExactMantissa) exact = false;
+			}
+			value = double(m) * 1e22;
+		} else exact = false;
+
+		if (exact) {
+			handler.floatValue(negative ? -value : value);
+			return;
+		}
+	}
+
+	// Slow path, correctly rounded by the C library
+	string text(begin, p);
+	handler.floatValue(strtod(text.c_str(), 0));
+}
+
+
+void JSONParser::parseInSitu(char *data, size_t size, JSONHandler &handler) {
+	if (size > size_t(numeric_limits<uint32_t>::max())) throw runtime_error("JSON input too large");
+	m_data = data;
+	m_size = size;
+	m_next = 0;
+	m_depth = 0;
+
+	buildIndex();
+	if (m_index.empty()) fail(m_size, "No value");
+	parseValue(handler);
+	if (m_next < m_index.size()) fail(m_index[m_next], "Unexpected data after value");
+
+	m_data = 0;
+	m_size = 0;
+}
+
+
+void JSONParser::parse(const char *data, size_t size, JSONHandler &handler) {
+	block_allocator::scope scratch(block_allocator::local());
+	char *copy = static_cast<char*>(scratch.allocator().malloc(size + 1));
+	memcpy(copy, data, size);
+	copy[size] = '\0';
+	parseInSitu(copy, size, handler);
+}
+
+
+bool JSONParser::simd() {
+	#ifdef __SSE2__
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+
+JSONParser::JSONParser()
+	: m_next(0), m_data(0), m_size(0), m_depth(0)
+{}
+
+
+JSONParser::~JSONParser() {}
+
+
+} // namespace froast
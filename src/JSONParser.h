@@ -0,0 +1,105 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_JSONPARSER_H
+#define FROAST_JSONPARSER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <stdint.h>
+
+
+namespace froast {
+
+
+///	@brief	Receives the events of a JSONParser
+///
+///	Names and string values are NUL-terminated and stay valid until the
+///	parser returns.
+class JSONHandler {
+public:
+	virtual void beginObject() {}
+	virtual void endObject() {}
+	virtual void beginArray() {}
+	virtual void endArray() {}
+	virtual void key(const char *name, size_t length) {}
+	virtual void stringValue(const char *value, size_t length) {}
+	virtual void intValue(int64_t value) {}
+	virtual void floatValue(double value) {}
+	virtual void boolValue(bool value) {}
+	virtual void nullValue() {}
+
+	virtual ~JSONHandler() {}
+};
+
+
+///	@brief	Two-stage JSON parser
+///
+///	Stage 1 classifies the input in blocks of 64 bytes (with SSE2 where
+///	available) and builds an index of all structural characters, string
+///	starts and scalar starts, tracking strings and escapes with bit masks
+///	instead of per-byte branches. Stage 2 walks the index and passes the
+///	values to a JSONHandler, unescaping strings in place. Floating point
+///	numbers are converted exactly with Clinger's fast path, falling back
+///	to strtod in the rare cases it doesn't cover.
+///
+///	Throws std::runtime_error on syntax errors. A parser can be reused,
+///	its index buffer is kept between calls.
+class JSONParser {
+protected:
+	std::vector<uint32_t> m_index;
+	size_t m_next;
+	char *m_data;
+	size_t m_size;
+	int m_depth;
+
+	void buildIndex();
+
+	void parseValue(JSONHandler &handler);
+	void parseObject(JSONHandler &handler);
+	void parseArray(JSONHandler &handler);
+	size_t parseString(size_t pos);
+	void parseNumber(size_t pos, JSONHandler &handler);
+	void parseLiteral(size_t pos, JSONHandler &handler);
+
+	size_t nextIndex();
+	char peek() const;
+	void fail(size_t pos, const char *desc) const;
+
+public:
+	///	@brief	Parse JSON text, modifying it
+	///
+	///	Strings are unescaped in place, so the text may be changed.
+	void parseInSitu(char *data, size_t size, JSONHandler &handler);
+
+	///	@brief	Parse JSON text, using a copy in thread-local scratch memory
+	void parse(const char *data, size_t size, JSONHandler &handler);
+
+	///	@brief	Check if stage 1 uses SIMD instructions
+	static bool simd();
+
+	JSONParser();
+	virtual ~JSONParser();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_JSONPARSER_H
@@ -0,0 +1,163 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "JSONWriter.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+void JSONWriter::grow(size_t minCapacity) {
+	size_t capacity = (m_capacity > 0) ? 2 * m_capacity : 64;
+	while (capacity < minCapacity) capacity *= 2;
+	char *data = static_cast<char*>(realloc(m_data, capacity));
+	if (data == 0) throw bad_alloc();
+	m_data = data;
+	m_capacity = capacity;
+}
+
+
+void JSONWriter::separate() {
+	if (m_afterKey) { m_afterKey = false; return; }
+	if (m_empty.empty()) return;
+	if (!m_empty.back()) put(", ", 2);
+	m_empty.back() = false;
+}
+
+
+void JSONWriter::putString(const char *s, size_t length) {
+	static const char hex[] = "0123456789abcdef";
+	put('"');
+	const char *end = s + length;
+	while (s < end) {
+		// Copy runs of characters that need no escaping in one go
+		const char *run = s;
+		while ((s < end) && (*s != '"') && (*s != '\\') && ((unsigned char)(*s) >= 0x20)) ++s;
+		if (s > run) put(run, s - run);
+		if (s == end) break;
+		char c = *s++;
+		switch (c) {
+			case '"': put("\\\"", 2); break;
+			case '\\': put("\\\\", 2); break;
+			case '\n': put("\\n", 2); break;
+			case '\t': put("\\t", 2); break;
+			case '\r': put("\\r", 2); break;
+			case '\b': put("\\b", 2); break;
+			case '\f': put("\\f", 2); break;
+			default: {
+				char esc[6] = { '\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf] };
+				put(esc, 6);
+			}
+		}
+	}
+	put('"');
+}
+
+
+size_t JSONWriter::formatInt(char *out, int64_t x) {
+	char digits[24];
+	size_t n = 0;
+	uint64_t u = (x < 0) ? uint64_t(0) - uint64_t(x) : uint64_t(x);
+	do { digits[n++] = char('0' + u % 10); u /= 10; } while (u > 0);
+	size_t pos = 0;
+	if (x < 0) out[pos++] = '-';
+	while (n > 0) out[pos++] = digits[--n];
+	return pos;
+}
+
+
+size_t JSONWriter::formatFloat(char *out, double x) {
+	if (!((x - x) == 0)) { memcpy(out, "null", 4); return 4; } // NaN or Inf
+	if ((fabs(x) < 9.2e18) && (x == double(int64_t(x)))) {
+		size_t n = formatInt(out, int64_t(x));
+		out[n++] = '.';
+		out[n++] = '0';
+		return n;
+	}
+	// Shortest of the two that reads back as the same value
+	int n = snprintf(out, max_number_length, "%.15g", x);
+	if (strtod(out, 0) != x) n = snprintf(out, max_number_length, "%.17g", x);
+	return size_t(n);
+}
+
+
+void JSONWriter::beginObject() { separate(); put('{'); m_empty.push_back(true); }
+
+void JSONWriter::endObject() { put('}'); m_empty.pop_back(); }
+
+void JSONWriter::beginArray() { separate(); put('['); m_empty.push_back(true); }
+
+void JSONWriter::endArray() { put(']'); m_empty.pop_back(); }
+
+
+void JSONWriter::key(const char *name, size_t length) {
+	separate();
+	putString(name, length);
+	put(": ", 2);
+	m_afterKey = true;
+}
+
+
+void JSONWriter::stringValue(const char *value, size_t length) { separate(); putString(value, length); }
+
+
+void JSONWriter::intValue(int64_t value) {
+	separate();
+	if (m_size + max_number_length > m_capacity) grow(m_size + max_number_length);
+	m_size += formatInt(m_data + m_size, value);
+}
+
+
+void JSONWriter::floatValue(double value) {
+	separate();
+	if (m_size + max_number_length > m_capacity) grow(m_size + max_number_length);
+	m_size += formatFloat(m_data + m_size, value);
+}
+
+
+void JSONWriter::boolValue(bool value) {
+	separate();
+	if (value) put("true", 4); else put("false", 5);
+}
+
+
+void JSONWriter::nullValue() { separate(); put("null", 4); }
+
+
+void JSONWriter::rawValue(const char *json, size_t length) { separate(); put(json, length); }
+
+
+JSONWriter::JSONWriter(size_t capacity)
+	: m_data(0), m_size(0), m_capacity(0), m_afterKey(false)
+{
+	if (capacity > 0) grow(capacity);
+}
+
+
+JSONWriter::~JSONWriter() { free(m_data); }
+
+
+} // namespace froast
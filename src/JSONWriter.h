@@ -0,0 +1,116 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_JSONWRITER_H
+#define FROAST_JSONWRITER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+
+#include <stdint.h>
+
+#include "JSONParser.h"
+
+
+namespace froast {
+
+
+///	@brief	Streaming JSON writer, emits directly into a growable memory buffer
+///
+///	Implements JSONHandler, so parser events can be passed through
+///	unchanged. The output format matches JSON::write (", " between members,
+///	": " after keys). Strings are escaped, non-finite numbers written as null.
+class JSONWriter: public JSONHandler {
+protected:
+	char *m_data;
+	size_t m_size;
+	size_t m_capacity;
+	std::vector<bool> m_empty;
+	bool m_afterKey;
+
+	void grow(size_t minCapacity);
+
+	void put(char c) {
+		if (m_size == m_capacity) grow(m_size + 1);
+		m_data[m_size++] = c;
+	}
+
+	void put(const char *s, size_t n) {
+		if (m_size + n > m_capacity) grow(m_size + n);
+		memcpy(m_data + m_size, s, n);
+		m_size += n;
+	}
+
+	void separate();
+	void putString(const char *s, size_t length);
+
+private:
+	JSONWriter(const JSONWriter &other);
+	JSONWriter& operator=(const JSONWriter &other);
+
+public:
+	///	@brief	Maximum length of a number formatted by formatInt or formatFloat
+	static const size_t max_number_length = 32;
+
+	///	@brief	Format an integer, returns the number of characters written
+	static size_t formatInt(char *out, int64_t x);
+
+	///	@brief	Format a floating point number like JSON::write
+	///
+	///	Integral values are written with a trailing ".0", all others with
+	///	15 significant digits, or 17 if needed to read back the same value.
+	///	Returns the number of characters written.
+	static size_t formatFloat(char *out, double x);
+
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	std::string str() const { return std::string(m_data, m_size); }
+
+	std::ostream& writeTo(std::ostream &out) const { return out.write(m_data, m_size); }
+
+	///	@brief	Discard the output, but keep the buffer memory
+	void clear() { m_size = 0; m_empty.clear(); m_afterKey = false; }
+
+	virtual void beginObject();
+	virtual void endObject();
+	virtual void beginArray();
+	virtual void endArray();
+	virtual void key(const char *name, size_t length);
+	virtual void stringValue(const char *value, size_t length);
+	virtual void intValue(int64_t value);
+	virtual void floatValue(double value);
+	virtual void boolValue(bool value);
+	virtual void nullValue();
+
+	void key(const char *name) { key(name, strlen(name)); }
+	void stringValue(const char *value) { stringValue(value, strlen(value)); }
+
+	///	@brief	Insert an already serialized JSON value
+	void rawValue(const char *json, size_t length);
+
+	JSONWriter(size_t capacity = 4096);
+	virtual ~JSONWriter();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_JSONWRITER_H
@@ -0,0 +1,280 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "LocalFile.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include <RVersion.h>
+#include <TROOT.h>
+#include <TUrl.h>
+#include <TPluginManager.h>
+#include <TChainElement.h>
+
+#include "logging.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace {
+
+pthread_mutex_t g_streamerInfoMutex = PTHREAD_MUTEX_INITIALIZER;
+std::set<ULong64_t> g_streamerInfoRead;
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,14,0)
+const bool defaultStreamerInfoCache = false;
+#else
+const bool defaultStreamerInfoCache = true;
+#endif
+
+// Setting as last looked up by url() or applyTo(), on the thread setting
+// up the input: files may be opened on other threads (e.g. the input
+// pipeline), which must not access the settings
+bool g_streamerInfoCache = defaultStreamerInfoCache;
+
+bool streamerInfoCacheEnabled() {
+	bool enabled = froast::GSettings::get("froast.input.streamerinfo.cache", defaultStreamerInfoCache);
+	__atomic_store_n(&g_streamerInfoCache, enabled, __ATOMIC_RELAXED);
+	return enabled;
+}
+
+bool hasScheme(const TString &url) {
+	return url.BeginsWith("mmap:") || url.BeginsWith("local:") || url.BeginsWith("file:");
+}
+
+} // namespace
+
+
+ClassImp(froast::LocalFile)
+
+
+namespace froast {
+
+
+Int_t LocalFile::SysOpen(const char *pathname, Int_t flags, UInt_t mode) {
+	int fd = ::open(pathname, flags, mode);
+	if (fd < 0) return fd;
+
+	#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	#endif
+
+	struct stat st;
+	if (m_useMap && (fstat(fd, &st) == 0) && (st.st_size > 0)) {
+		void *addr = mmap(0, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		if (addr != MAP_FAILED) {
+			m_map = static_cast<char*>(addr);
+			m_mapSize = st.st_size;
+			madvise(m_map, size_t(m_mapSize), MADV_SEQUENTIAL);
+			madvise(m_map, size_t(m_mapSize), MADV_WILLNEED);
+		} else {
+			log_debug("Can't memory-map \"%s\", using plain reads", pathname);
+			#ifdef POSIX_FADV_WILLNEED
+			posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+			#endif
+		}
+	}
+	m_pos = 0;
+	return fd;
+}
+
+
+void LocalFile::unmap() {
+	if (m_map != 0) munmap(m_map, size_t(m_mapSize));
+	m_map = 0;
+	m_mapSize = 0;
+}
+
+
+Int_t LocalFile::SysClose(Int_t fd) {
+	unmap();
+	return (fd >= 0) ? ::close(fd) : 0;
+}
+
+
+Int_t LocalFile::SysRead(Int_t fd, void *buf, Int_t len) {
+	if (m_map == 0) {
+		ssize_t n = pread(fd, buf, size_t(len), m_pos);
+		if (n > 0) m_pos += n;
+		return Int_t(n);
+	}
+	if ((m_pos < 0) || (m_pos >= m_mapSize)) return 0;
+	Int_t n = Int_t(std::min(Long64_t(len), m_mapSize - m_pos));
+	memcpy(buf, m_map + m_pos, size_t(n));
+	m_pos += n;
+	return n;
+}
+
+
+Long64_t LocalFile::SysSeek(Int_t fd, Long64_t offset, Int_t whence) {
+	Long64_t pos = 0;
+	switch (whence) {
+		case SEEK_SET: pos = offset; break;
+		case SEEK_CUR: pos = m_pos + offset; break;
+		case SEEK_END: {
+			struct stat st;
+			if (fstat(fd, &st) != 0) return -1;
+			pos = st.st_size + offset;
+			break;
+		}
+		default: errno = EINVAL; return -1;
+	}
+	if (pos < 0) { errno = EINVAL; return -1; }
+	m_pos = pos;
+	return m_pos;
+}
+
+
+Int_t LocalFile::SysStat(Int_t fd, Long_t *id, Long64_t *size, Long_t *flags, Long_t *modtime) {
+	struct stat st;
+	if (fstat(fd, &st) != 0) return 1;
+	if (id != 0) *id = (Long_t(st.st_dev) << 24) + Long_t(st.st_ino);
+	if (size != 0) *size = st.st_size;
+	if (flags != 0) *flags = 0;
+	if (modtime != 0) *modtime = Long_t(st.st_mtime);
+	return 0;
+}
+
+
+ULong64_t LocalFile::streamerInfoChecksum() {
+	if ((fSeekInfo <= fBEGIN) || (fNbytesInfo <= 14)) return 0;
+	std::vector<unsigned char> buffer(fNbytesInfo);
+	if (ReadBuffer(reinterpret_cast<char*>(&buffer[0]), fSeekInfo, fNbytesInfo)) return 0;
+
+	// Skip the key header, it contains file-specific seek positions and
+	// date, but include the uncompressed length (bytes 6-9)
+	Int_t keyLen = (Int_t(buffer[14]) << 8) | Int_t(buffer[15]);
+	if ((keyLen < 16) || (keyLen >= fNbytesInfo)) return 0;
+	ULong64_t hash = 14695981039346656037ULL;
+	for (Int_t i = 6; i < 10; ++i) { hash ^= buffer[i]; hash *= 1099511628211ULL; }
+	for (Int_t i = keyLen; i < fNbytesInfo; ++i) { hash ^= buffer[i]; hash *= 1099511628211ULL; }
+	return hash;
+}
+
+
+void LocalFile::ReadStreamerInfo() {
+	if (!m_streamerInfoCache) { TFile::ReadStreamerInfo(); return; }
+
+	ULong64_t checksum = streamerInfoChecksum();
+	if (checksum != 0) {
+		pthread_mutex_lock(&g_streamerInfoMutex);
+		bool known = (g_streamerInfoRead.find(checksum) != g_streamerInfoRead.end());
+		pthread_mutex_unlock(&g_streamerInfoMutex);
+		if (known) {
+			log_trace("StreamerInfo of \"%s\" already known, skipping", GetName());
+			return;
+		}
+	}
+
+	TFile::ReadStreamerInfo();
+
+	if ((checksum != 0) && !IsZombie()) {
+		pthread_mutex_lock(&g_streamerInfoMutex);
+		g_streamerInfoRead.insert(checksum);
+		pthread_mutex_unlock(&g_streamerInfoMutex);
+	}
+}
+
+
+void LocalFile::registerPlugin() {
+	static bool registered = false;
+	if (registered) return;
+	gROOT->GetPluginManager()->AddHandler("TFile", "^mmap:", "froast::LocalFile",
+		"froast", "LocalFile(const char*,Option_t*,const char*,Int_t)");
+	gROOT->GetPluginManager()->AddHandler("TFile", "^local:", "froast::LocalFile",
+		"froast", "LocalFile(const char*,Option_t*,const char*,Int_t)");
+	registered = true;
+}
+
+
+bool LocalFile::isLocal(const TString &fileName) {
+	if (hasScheme(fileName)) return true;
+	return (fileName.Index(":") < 0);
+}
+
+
+TString LocalFile::url(const TString &fileName) {
+	if (fileName.BeginsWith("mmap:") || fileName.BeginsWith("local:") || !isLocal(fileName)) return fileName;
+	TString scheme;
+	bool streamerInfoCache = streamerInfoCacheEnabled();
+	if (GSettings::get("froast.input.mmap", false)) scheme = "mmap:";
+	else if (streamerInfoCache) scheme = "local:";
+	else return fileName;
+	registerPlugin();
+	TString path = fileName.BeginsWith("file:") ? TString(TUrl(fileName.Data()).GetFile()) : fileName;
+	return scheme + path;
+}
+
+
+void LocalFile::applyTo(TChain *chain) {
+	bool streamerInfoCache = streamerInfoCacheEnabled();
+	if (!GSettings::get("froast.input.mmap", false) && !streamerInfoCache) return;
+	TObjArray *chainElems = chain->GetListOfFiles();
+	for (int i = 0; i < chainElems->GetEntriesFast(); ++i) {
+		TChainElement *e = dynamic_cast<TChainElement*>(chainElems->At(i));
+		if (e != 0) e->SetTitle(url(e->GetTitle()));
+	}
+}
+
+
+LocalFile::LocalFile(const char *url, Option_t *option, const char *ftitle, Int_t compress)
+	: TFile(url, "WEB", ftitle, compress), m_useMap(true), m_streamerInfoCache(true), m_map(0), m_mapSize(0), m_pos(0)
+{
+	// The "WEB" option makes TFile skip opening the file, so our Sys*
+	// overrides are in effect for opening and Init()
+	TString opt(option);
+	opt.ToUpper();
+	if ((opt != "") && (opt != "READ"))
+		throw invalid_argument(string("LocalFile only supports read-only access, can't open \"") + url + "\" with option " + option);
+
+	m_useMap = !TString(url).BeginsWith("local:");
+	// "local:" is only used for the StreamerInfo cache
+	m_streamerInfoCache = !m_useMap || __atomic_load_n(&g_streamerInfoCache, __ATOMIC_RELAXED);
+	TString path = hasScheme(url) ? TString(TUrl(url).GetFile()) : TString(url);
+	fRealName = path;
+	fD = SysOpen(path.Data(), O_RDONLY, 0644);
+	if (fD < 0) {
+		log_error("LocalFile: Can't open \"%s\" for reading (%s)", path.Data(), strerror(errno));
+		MakeZombie();
+		gDirectory = gROOT;
+		return;
+	}
+	Init(kFALSE);
+}
+
+
+LocalFile::~LocalFile() {
+	Close();
+	unmap();
+}
+
+
+} // namespace froast
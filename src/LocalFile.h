@@ -0,0 +1,112 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_LOCALFILE_H
+#define FROAST_LOCALFILE_H
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TChain.h>
+
+
+namespace froast {
+
+
+///	@brief	Read-only TFile backend for local files
+///
+///	With the URL scheme "mmap:" (e.g. "mmap:/data/run01.root"), maps the
+///	whole file into memory and advises the kernel of sequential access,
+///	so basket reads become copies from the page cache instead of
+///	individual pread calls. Falls back to plain reads if the file can't
+///	be mapped. With the URL scheme "local:", uses plain reads.
+///
+///	Both schemes skip reading StreamerInfo records that are identical to
+///	one already read in this process (compared by checksum of the
+///	compressed record), as the classes and streamers built from it are
+///	already known to ROOT. Runs over many files with the same schema
+///	save a decompression and deserialization per file this way. "local:"
+///	always uses this cache, "mmap:" if it was enabled when url() or
+///	applyTo() last ran: files may be opened on helper threads, which
+///	don't read the settings.
+///
+///	Registered as TFile plugin for "mmap:" and "local:", so it works with
+///	TFile::Open and TChain.
+///
+///	Settings:
+///	- "froast.input.mmap": Use the "mmap:" backend for all local input
+///	  files opened by froast (default: false)
+///	- "froast.input.streamerinfo.cache": Use the "local:" backend with the
+///	  StreamerInfo cache for all local input files opened by froast, unless
+///	  mmap is enabled (default: true before ROOT 6.14, false after, since
+///	  ROOT caches StreamerInfo records by checksum itself from 6.14 on)
+
+class LocalFile: public TFile {
+protected:
+	bool m_useMap;
+	bool m_streamerInfoCache;
+	char *m_map;
+	Long64_t m_mapSize;
+	Long64_t m_pos;
+
+	virtual Int_t SysOpen(const char *pathname, Int_t flags, UInt_t mode);
+	virtual Int_t SysClose(Int_t fd);
+	virtual Int_t SysRead(Int_t fd, void *buf, Int_t len);
+	virtual Long64_t SysSeek(Int_t fd, Long64_t offset, Int_t whence);
+	virtual Int_t SysStat(Int_t fd, Long_t *id, Long64_t *size, Long_t *flags, Long_t *modtime);
+
+	void unmap();
+
+	///	@brief	Checksum of the StreamerInfo record, 0 on failure
+	ULong64_t streamerInfoChecksum();
+
+public:
+	///	@brief	Register the "mmap:" and "local:" TFile plugin handlers (only once)
+	static void registerPlugin();
+
+	///	@brief	Check whether a file name refers to a local file
+	static bool isLocal(const TString &fileName);
+
+	///	@brief	URL to open an input file with
+	///
+	///	Returns "mmap:" + path for local files if the setting
+	///	"froast.input.mmap" is enabled, "local:" + path if the StreamerInfo
+	///	cache is enabled, else fileName unchanged.
+	static TString url(const TString &fileName);
+
+	///	@brief	Use this backend for the local files of a chain
+	///
+	///	Only has an effect if mmap or the StreamerInfo cache is enabled.
+	static void applyTo(TChain *chain);
+
+	///	@brief	Open a file (must be local), read-only
+	///	@param	url	File path, optionally prefixed by "mmap:", "local:" or "file:"
+	LocalFile(const char *url, Option_t *option = "READ", const char *ftitle = "", Int_t compress = 1);
+
+	virtual ~LocalFile();
+
+	virtual void ReadStreamerInfo();
+
+	ClassDef(LocalFile, 0);
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_LOCALFILE_H
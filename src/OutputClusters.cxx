@@ -0,0 +1,118 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "OutputClusters.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <RVersion.h>
+
+#include "logging.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+OutputClusters::Policy OutputClusters::policy() {
+	TString name = GSettings::get("froast.output.cluster.policy", "default");
+	if (name == "default") return CP_DEFAULT;
+	else if (name == "size") return CP_SIZE;
+	else if (name == "entries") return CP_ENTRIES;
+	else if (name == "input") return CP_INPUT;
+	else throw invalid_argument(Form("Unknown output cluster policy \"%s\"", name.Data()));
+}
+
+
+Long64_t OutputClusters::autoFlush(TTree *input) {
+	switch (policy()) {
+		case CP_SIZE:
+			return -Long64_t(GSettings::get("froast.output.cluster.size", 32.0) * 1024 * 1024);
+		case CP_ENTRIES:
+			return std::max(Long64_t(1), Long64_t(GSettings::get("froast.output.cluster.entries", 100000)));
+		case CP_INPUT: {
+			if (input == 0) return 0;
+			TTree *tree = input->GetTree();
+			if ((tree == 0) && (input->LoadTree(0) >= 0)) tree = input->GetTree();
+			return (tree != 0) ? tree->GetAutoFlush() : 0;
+		}
+		default:
+			return 0;
+	}
+}
+
+
+void OutputClusters::configure(TTree *output, TTree *input) {
+	Long64_t value = autoFlush(input);
+	if (value == 0) return;
+	output->SetAutoFlush(value);
+	log_debug("Output tree \"%s\": AutoFlush %lli", output->GetName(), (long long)value);
+}
+
+
+void OutputClusters::outputTo(TTree *output, TTree *input) {
+	m_policy = policy();
+	m_output = output;
+	m_inputTree = 0;
+	m_clusterStart = m_clusterEnd = -1;
+	m_outputMark = 0;
+
+	if (m_policy == CP_INPUT) {
+		#if ROOT_VERSION_CODE >= ROOT_VERSION(6,14,0)
+		// Clusters are closed explicitly by inputEntry()
+		output->SetAutoFlush(0);
+		return;
+		#else
+		// Can't mark cluster boundaries, fall back to the input AutoFlush
+		m_output = 0;
+		#endif
+	}
+	configure(output, input);
+}
+
+
+void OutputClusters::nextInputCluster(TTree *input, Long64_t entry) {
+	TTree *current = input->GetTree();
+	Long64_t outputEntries = m_output->GetEntriesFast();
+	if ((m_inputTree != 0) && (outputEntries > m_outputMark)) {
+		#if ROOT_VERSION_CODE >= ROOT_VERSION(6,14,0)
+		// Also marks the end of the event cluster
+		m_output->FlushBaskets();
+		#endif
+		m_outputMark = outputEntries;
+	}
+	m_inputTree = current;
+	TTree::TClusterIterator clusters = current->GetClusterIterator(entry);
+	m_clusterStart = clusters.Next();
+	m_clusterEnd = clusters.GetNextEntry();
+}
+
+
+OutputClusters::OutputClusters()
+	: m_policy(CP_DEFAULT), m_output(0), m_inputTree(0), m_clusterStart(-1), m_clusterEnd(-1), m_outputMark(0)
+{}
+
+
+OutputClusters::~OutputClusters() {}
+
+
+} // namespace froast
@@ -0,0 +1,108 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_OUTPUTCLUSTERS_H
+#define FROAST_OUTPUTCLUSTERS_H
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TTree.h>
+
+
+namespace froast {
+
+
+///	@brief	Cluster (AutoFlush) policies for output trees
+///
+///	Policies:
+///	- "default": Keep ROOT's AutoFlush (or the one tuned by basket
+///	  autotuning, see OutputBranchManager)
+///	- "size": Clusters of about "froast.output.cluster.size" MB
+///	- "entries": Clusters of "froast.output.cluster.entries" entries
+///	- "input": Align output clusters with the clusters of the input tree.
+///	  For entry-by-entry output (TreeMapperSel), a cluster is closed
+///	  whenever the input moves to a new cluster (requires ROOT 6.14),
+///	  otherwise the output uses the AutoFlush of the input tree.
+///
+///	With "size", ROOT determines the number of entries per cluster from
+///	the compressed size of the first cluster. Basket autotuning refines it
+///	based on the uncompressed size.
+///
+///	Settings:
+///	- "froast.output.cluster.policy": Policy (default: "default")
+///	- "froast.output.cluster.size": Cluster size in MB (default: 32)
+///	- "froast.output.cluster.entries": Entries per cluster (default: 100000)
+
+class OutputClusters {
+public:
+	enum Policy {
+		CP_DEFAULT = 0,
+		CP_SIZE    = 1,
+		CP_ENTRIES = 2,
+		CP_INPUT   = 3
+	};
+
+protected:
+	Policy m_policy;
+	TTree *m_output;
+	TTree *m_inputTree;
+	Long64_t m_clusterStart;
+	Long64_t m_clusterEnd;
+	Long64_t m_outputMark;
+
+	void nextInputCluster(TTree *input, Long64_t entry);
+
+public:
+	///	@brief	Policy from the settings
+	///
+	///	Throws on unknown policies.
+	static Policy policy();
+
+	///	@brief	AutoFlush value for an output tree according to the policy
+	///	@param	input	Tree the output is derived from (optional)
+	///	@return	AutoFlush value, 0 to keep the tree's current one
+	static Long64_t autoFlush(TTree *input = 0);
+
+	///	@brief	Apply the policy to an output tree
+	static void configure(TTree *output, TTree *input = 0);
+
+	///	@brief	Set up an output tree filled entry by entry
+	///
+	///	Call inputEntry() before filling the output for each input entry.
+	void outputTo(TTree *output, TTree *input = 0);
+
+	///	@brief	Close the current output cluster on input cluster boundaries ("input" policy)
+	///	@param	input	Input tree or chain
+	///	@param	entry	Entry number within the current tree of the input
+	///
+	///	Cheap enough to be called for every entry.
+	void inputEntry(TTree *input, Long64_t entry) {
+		if ((m_policy != CP_INPUT) || (m_output == 0)) return;
+		if ((input->GetTree() != m_inputTree) || (entry >= m_clusterEnd) || (entry < m_clusterStart))
+			nextInputCluster(input, entry);
+	}
+
+	OutputClusters();
+	virtual ~OutputClusters();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_OUTPUTCLUSTERS_H
@@ -0,0 +1,186 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "OutputCompression.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <string>
+
+#include <RVersion.h>
+#include <RZip.h>
+#include <TBasket.h>
+#include <TObjArray.h>
+
+#include "logging.h"
+#include "PerfStats.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+void zip(int32_t algorithm, int32_t level, int *srcSize, char *src, int *tgtSize, char *tgt, int *irep) {
+	#if ROOT_VERSION_CODE >= ROOT_VERSION(6,20,0)
+	R__zipMultipleAlgorithm(level, srcSize, src, tgtSize, tgt, irep,
+		ROOT::RCompressionSetting::EAlgorithm::EValues(algorithm));
+	#elif ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+	R__zipMultipleAlgorithm(level, srcSize, src, tgtSize, tgt, irep,
+		static_cast<ROOT::ECompressionAlgorithm>(algorithm));
+	#else
+	R__zipMultipleAlgorithm(level, srcSize, src, tgtSize, tgt, irep, algorithm);
+	#endif
+}
+
+const Int_t minSampleSize = 256;
+
+} // namespace
+
+
+bool OutputCompression::available(int32_t algorithm) {
+	switch (algorithm) {
+		case CA_DEFAULT: case CA_ZLIB: case CA_LZMA: return true;
+		#if ROOT_VERSION_CODE >= ROOT_VERSION(6,12,0)
+		case CA_LZ4: return true;
+		#endif
+		#if ROOT_VERSION_CODE >= ROOT_VERSION(6,20,0)
+		case CA_ZSTD: return true;
+		#endif
+		default: return false;
+	}
+}
+
+
+int32_t OutputCompression::profileSettings(const TString &profile) {
+	if (profile.Length() == 0) return -1;
+	else if (profile == "fast-write")
+		return available(CA_LZ4) ? settings(CA_LZ4, 1) : settings(CA_ZLIB, 1);
+	else if ((profile == "balanced") || (profile == "auto"))
+		return available(CA_ZSTD) ? settings(CA_ZSTD, 5) : settings(CA_ZLIB, 4);
+	else if (profile == "archive")
+		return available(CA_ZSTD) ? settings(CA_ZSTD, 9) : settings(CA_LZMA, 8);
+	else throw invalid_argument(string("Unknown compression profile \"") + profile.Data() + "\"");
+}
+
+
+TString OutputCompression::profile(const char* treeName, const char* branchName) {
+	if (branchName != 0) {
+		TString key = TString::Format("froast.output.branch.%s.compression.profile", branchName);
+		if (Settings::current().defined(key.Data())) return GSettings::get(key.Data(), "", false);
+	}
+	if (treeName != 0) {
+		TString key = TString::Format("froast.output.tree.%s.compression.profile", treeName);
+		if (Settings::current().defined(key.Data())) return GSettings::get(key.Data(), "", false);
+	}
+	if (Settings::current().defined("froast.output.compression.profile"))
+		return GSettings::get("froast.output.compression.profile", "", false);
+	return "";
+}
+
+
+void OutputCompression::configure(TFile *file) {
+	int32_t compression = profileSettings(profile());
+	if (compression >= 0) file->SetCompressionSettings(compression);
+	else file->SetCompressionLevel(GSettings::get("froast.tfile.compression.level", 1));
+}
+
+
+int32_t OutputCompression::trial(const char *data, Int_t size) {
+	static const int32_t candidates[][2] = {
+		{ CA_LZ4, 1 }, { CA_LZ4, 4 }, { CA_ZLIB, 1 }, { CA_ZLIB, 6 },
+		{ CA_ZSTD, 3 }, { CA_ZSTD, 5 }, { CA_ZSTD, 9 }, { CA_LZMA, 4 }
+	};
+	const size_t nCandidates = sizeof(candidates) / sizeof(candidates[0]);
+
+	const double mb = 1024. * 1024.;
+	double writeSpeed = GSettings::get("froast.output.compression.auto.write.speed", 200.0) * mb;
+	double readSpeed = GSettings::get("froast.output.compression.auto.read.speed", 500.0) * mb;
+	double nReads = GSettings::get("froast.output.compression.auto.reads", 1.0);
+
+	std::vector<char> src(data, data + size);
+	// Compressed output larger than the input is useless, leave room for the header:
+	std::vector<char> zipped(size + 64);
+	std::vector<char> unzipped(size);
+
+	int32_t best = -1;
+	double bestCost = numeric_limits<double>::max();
+	for (size_t i = 0; i < nCandidates; ++i) {
+		int32_t algorithm = candidates[i][0], level = candidates[i][1];
+		if (!available(algorithm)) continue;
+
+		int srcSize = size, tgtSize = size, zipSize = 0;
+		double t0 = PerfStats::now();
+		zip(algorithm, level, &srcSize, &src[0], &tgtSize, &zipped[0], &zipSize);
+		double t1 = PerfStats::now();
+		if ((zipSize <= 0) || (zipSize >= size)) continue;
+
+		int unzipSrcSize = zipSize, unzipTgtSize = size, unzipSize = 0;
+		R__unzip(&unzipSrcSize, reinterpret_cast<unsigned char*>(&zipped[0]), &unzipTgtSize,
+			reinterpret_cast<unsigned char*>(&unzipped[0]), &unzipSize);
+		double t2 = PerfStats::now();
+		if (unzipSize != size) continue;
+
+		double cost = (t1 - t0) + zipSize / writeSpeed + nReads * ((t2 - t1) + zipSize / readSpeed);
+		log_trace("Compression trial: algorithm %i, level %i: ratio %.2f, cost %.3g s",
+			algorithm, level, double(size) / double(zipSize), cost);
+		if (cost < bestCost) { bestCost = cost; best = settings(algorithm, level); }
+	}
+
+	// Storing uncompressed may be best:
+	if ((best >= 0) && (size / writeSpeed + nReads * size / readSpeed < bestCost)) best = 0;
+	return best;
+}
+
+
+int OutputCompression::tune(TBranch *branch) {
+	TObjArray *subBranches = branch->GetListOfBranches();
+	if ((subBranches != 0) && (subBranches->GetEntriesFast() > 0)) {
+		int n = 0;
+		bool tooSmall = false;
+		for (Int_t i = 0; i < subBranches->GetEntriesFast(); ++i) {
+			TBranch *sub = dynamic_cast<TBranch*>(subBranches->At(i));
+			if (sub == 0) continue;
+			int nSub = tune(sub);
+			if (nSub < 0) tooSmall = true;
+			else n += nSub;
+		}
+		return ((n == 0) && tooSmall) ? -1 : n;
+	}
+
+	TBasket *basket = branch->GetBasket(branch->GetWriteBasket());
+	if ((basket == 0) || (basket->GetBufferRef() == 0)) return -1;
+	const char *data = basket->GetBufferRef()->Buffer() + basket->GetKeylen();
+	Int_t size = basket->GetBufferRef()->Length() - basket->GetKeylen();
+	size = std::min(size, Int_t(GSettings::get("froast.output.compression.auto.sample", 1024 * 1024)));
+	if (size < minSampleSize) return -1;
+
+	int32_t best = trial(data, size);
+	if (best < 0) return 0;
+	branch->SetCompressionSettings(best);
+	log_debug("Compression of branch \"%s\" set to %i, based on %li bytes", branch->GetName(), best, (long)size);
+	return 1;
+}
+
+
+} // namespace froast
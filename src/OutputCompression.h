@@ -0,0 +1,105 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_OUTPUTCOMPRESSION_H
+#define FROAST_OUTPUTCOMPRESSION_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TBranch.h>
+
+
+namespace froast {
+
+
+///	@brief	Compression profiles for output files, trees and branches
+///
+///	Profiles:
+///	- "fast-write": LZ4, level 1 (ZLIB 1 before ROOT 6.12)
+///	- "balanced": ZSTD, level 5 (ZLIB 4 before ROOT 6.20)
+///	- "archive": ZSTD, level 9 (LZMA 8 before ROOT 6.20)
+///	- "auto": Start with "balanced", then trial-compress a sample of each
+///	  branch's data with a set of candidates and choose the one with the
+///	  lowest estimated write plus read time per byte
+///
+///	Settings:
+///	- "froast.output.compression.profile": Profile for output files (by
+///	  default, "froast.tfile.compression.level" is used as before)
+///	- "froast.output.tree.TREE.compression.profile": Profile for the
+///	  branches of a tree
+///	- "froast.output.branch.BRANCH.compression.profile": Profile for a
+///	  branch
+///	- "froast.output.compression.auto.entries": Number of entries to fill
+///	  before sampling (default: 1000)
+///	- "froast.output.compression.auto.write.speed",
+///	  "froast.output.compression.auto.read.speed": Target storage write and
+///	  read speed in MB/s (defaults: 200, 500)
+///	- "froast.output.compression.auto.reads": Expected number of times the
+///	  output will be read (default: 1)
+///
+///	Explicit "compression.algorithm" and "compression.level" branch
+///	parameters (see BranchOutputParams) take precedence over profiles.
+
+class OutputCompression {
+public:
+	///	@brief	Compression algorithms, numbered as in ROOT
+	enum Algorithm {
+		CA_DEFAULT = 0,
+		CA_ZLIB = 1,
+		CA_LZMA = 2,
+		CA_LZ4 = 4,
+		CA_ZSTD = 5
+	};
+
+	///	@brief	Compression settings in ROOT's encoding (algorithm * 100 + level)
+	static int32_t settings(int32_t algorithm, int32_t level) { return algorithm * 100 + level; }
+
+	///	@brief	Check whether an algorithm is supported by the ROOT version
+	static bool available(int32_t algorithm);
+
+	///	@brief	Compression settings of a profile, the "auto" profile starts as "balanced"
+	///	@return	Settings, or -1 if profile is empty
+	///
+	///	Throws on unknown profiles.
+	static int32_t profileSettings(const TString &profile);
+
+	///	@brief	Profile for a branch of a tree, resolved from the settings
+	static TString profile(const char* treeName = 0, const char* branchName = 0);
+
+	///	@brief	Set up compression of an output file
+	static void configure(TFile *file);
+
+	///	@brief	Find the best candidate settings for a data sample
+	///	@return	Settings, or -1 if no candidate could compress the sample
+	static int32_t trial(const char *data, Int_t size);
+
+	///	@brief	Trial-compress a branch's unflushed data and apply the best settings
+	///	@return	Number of (sub-)branches tuned, -1 if the sample was too small
+	static int tune(TBranch *branch);
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_OUTPUTCOMPRESSION_H
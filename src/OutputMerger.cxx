@@ -0,0 +1,152 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "OutputMerger.h"
+
+#include <stdexcept>
+#include <map>
+#include <memory>
+
+#include <pthread.h>
+
+#include <RVersion.h>
+#include <TROOT.h>
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,10,0)
+#include <ROOT/TBufferMerger.hxx>
+#define FROAST_WITH_TBUFFERMERGER
+#endif
+
+#include "logging.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+OutputMerger *g_activeMerger = 0;
+
+} // namespace
+
+
+#ifdef FROAST_WITH_TBUFFERMERGER
+
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,22,0)
+typedef ROOT::TBufferMerger TBufferMerger;
+typedef ROOT::TBufferMergerFile TBufferMergerFile;
+#else
+typedef ROOT::Experimental::TBufferMerger TBufferMerger;
+typedef ROOT::Experimental::TBufferMergerFile TBufferMergerFile;
+#endif
+
+class OutputMerger::Impl {
+public:
+	TBufferMerger merger;
+	std::map<TDirectory*, std::shared_ptr<TBufferMergerFile> > writers;
+	pthread_mutex_t mutex;
+
+	Impl(const TString &fileName, Int_t compression)
+		: merger(fileName.Data(), "RECREATE", compression)
+		{ pthread_mutex_init(&mutex, 0); }
+
+	~Impl() { pthread_mutex_destroy(&mutex); }
+};
+
+#else // not FROAST_WITH_TBUFFERMERGER
+
+class OutputMerger::Impl {};
+
+#endif // FROAST_WITH_TBUFFERMERGER
+
+
+bool OutputMerger::supported() {
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+
+OutputMerger* OutputMerger::active() { return g_activeMerger; }
+
+void OutputMerger::activate(OutputMerger *merger) { g_activeMerger = merger; }
+
+
+TDirectory* OutputMerger::openWriter() {
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	std::shared_ptr<TBufferMergerFile> file = m_impl->merger.GetFile();
+	pthread_mutex_lock(&m_impl->mutex);
+	m_impl->writers[file.get()] = file;
+	pthread_mutex_unlock(&m_impl->mutex);
+	return file.get();
+	#else
+	return 0;
+	#endif
+}
+
+
+void OutputMerger::flush(TDirectory *writer) {
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	if (writer != 0) writer->Write();
+	#endif
+}
+
+
+void OutputMerger::closeWriter(TDirectory *writer) {
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	if (writer == 0) return;
+	writer->Write();
+	pthread_mutex_lock(&m_impl->mutex);
+	m_impl->writers.erase(writer);
+	pthread_mutex_unlock(&m_impl->mutex);
+	#endif
+}
+
+
+OutputMerger::OutputMerger(const TString &fileName, Int_t compression)
+	: m_impl(0)
+{
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	ROOT::EnableThreadSafety();
+	m_impl = new Impl(fileName, compression);
+	log_debug("Opened merged output file \"%s\"", fileName.Data());
+	#else
+	throw runtime_error("Merged output requires ROOT 6.10 or newer");
+	#endif
+}
+
+
+OutputMerger::~OutputMerger() {
+	if (g_activeMerger == this) g_activeMerger = 0;
+	#ifdef FROAST_WITH_TBUFFERMERGER
+	if (m_impl != 0) {
+		if (!m_impl->writers.empty())
+			log_warn("Closing merged output with %li writers still open", long(m_impl->writers.size()));
+		m_impl->writers.clear();
+	}
+	#endif
+	delete m_impl;
+}
+
+
+} // namespace froast
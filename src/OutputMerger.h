@@ -0,0 +1,89 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_OUTPUTMERGER_H
+#define FROAST_OUTPUTMERGER_H
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TDirectory.h>
+
+
+namespace froast {
+
+
+///	@brief	Output file shared by several writer threads
+///
+///	Wraps ROOT's TBufferMerger (ROOT 6.10 and above): Each writer gets its
+///	own in-memory file, whose contents are sent to a background thread and
+///	merged into the output file on flush(). Writers may be used from
+///	different threads concurrently, each one by a single thread.
+///
+///	While an OutputMerger is active (see activate()), TreeMapperSel writes
+///	its output tree through a writer of it instead of the current
+///	directory. Used by FroastTools::reduce to run a selector in several
+///	threads.
+///
+///	Settings:
+///	- "froast.output.merger.flush.entries": Number of entries after which
+///	  TreeMapperSel flushes its writer (default: 100000)
+
+class OutputMerger {
+protected:
+	class Impl;
+	Impl *m_impl;
+
+	OutputMerger(const OutputMerger &other);
+	OutputMerger& operator=(const OutputMerger &other);
+
+public:
+	///	@brief	Check whether the ROOT version supports merged output
+	static bool supported();
+
+	///	@brief	Currently active merger, or 0
+	static OutputMerger* active();
+
+	///	@brief	Make this the active merger, or deactivate (if 0)
+	static void activate(OutputMerger *merger);
+
+	///	@brief	Get a new writer, to be used by one thread
+	///	@return	Directory to create output objects in
+	TDirectory* openWriter();
+
+	///	@brief	Send the data written so far to the output file
+	void flush(TDirectory *writer);
+
+	///	@brief	Flush and release a writer
+	///
+	///	Objects created in the writer are deleted.
+	void closeWriter(TDirectory *writer);
+
+	///	@brief	Open an output file for merged output
+	///
+	///	Throws if not supported by the ROOT version.
+	OutputMerger(const TString &fileName, Int_t compression = 1);
+
+	///	@brief	Close the output file, after all writers have been closed
+	virtual ~OutputMerger();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_OUTPUTMERGER_H
@@ -0,0 +1,157 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+
+#include "PerfStats.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+
+#include <pthread.h>
+#include <time.h>
+
+#include <TObjString.h>
+
+#include "logging.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+pthread_mutex_t g_jobMutex = PTHREAD_MUTEX_INITIALIZER;
+PerfStats g_job;
+bool g_logAtExit = false;
+bool g_atExitRegistered = false;
+
+__thread PerfStats *t_currentStats = 0;
+
+bool slowerThan(const PerfStats::Totals::const_iterator &a, const PerfStats::Totals::const_iterator &b)
+	{ return a->second.seconds > b->second.seconds; }
+
+} // namespace
+
+
+void PerfStats::add(const std::string &phase, double seconds, Long64_t calls) {
+	Total &total = m_totals[phase];
+	total.seconds += seconds;
+	total.calls += calls;
+}
+
+
+double PerfStats::seconds(const std::string &phase) const {
+	Totals::const_iterator it = m_totals.find(phase);
+	return (it != m_totals.end()) ? it->second.seconds : 0;
+}
+
+
+void PerfStats::writeJSON(JSONWriter &json) const {
+	json.beginObject();
+	for (Totals::const_iterator it = m_totals.begin(); it != m_totals.end(); ++it) {
+		json.key(it->first.data(), it->first.size());
+		json.beginObject();
+		json.key("seconds"); json.floatValue(it->second.seconds);
+		json.key("calls"); json.intValue(it->second.calls);
+		json.endObject();
+	}
+	json.endObject();
+}
+
+
+void PerfStats::log(const char *title) const {
+	if (m_totals.empty()) return;
+	vector<Totals::const_iterator> phases;
+	for (Totals::const_iterator it = m_totals.begin(); it != m_totals.end(); ++it) phases.push_back(it);
+	stable_sort(phases.begin(), phases.end(), slowerThan);
+	log_info("%s:", title);
+	for (size_t i = 0; i < phases.size(); ++i) {
+		log_info("  %-40s %10.3f s  %8lli calls", phases[i]->first.c_str(),
+			phases[i]->second.seconds, (long long)phases[i]->second.calls);
+	}
+}
+
+
+void PerfStats::writeToGDirectory(const TString &name) const {
+	JSONWriter json;
+	writeJSON(json);
+	TObjString perfOut(json.str().c_str());
+	perfOut.Write(name.Data(), TObject::kOverwrite);
+}
+
+
+double PerfStats::now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) + 1e-9 * double(ts.tv_nsec);
+}
+
+
+void PerfStats::record(const std::string &phase, double seconds) {
+	pthread_mutex_lock(&g_jobMutex);
+	g_job.add(phase, seconds);
+	pthread_mutex_unlock(&g_jobMutex);
+	if (t_currentStats != 0) t_currentStats->add(phase, seconds);
+}
+
+
+PerfStats PerfStats::job() {
+	pthread_mutex_lock(&g_jobMutex);
+	PerfStats stats(g_job);
+	pthread_mutex_unlock(&g_jobMutex);
+	return stats;
+}
+
+
+PerfStats* PerfStats::current() { return t_currentStats; }
+
+
+void PerfStats::logJobTotals() {
+	if (g_logAtExit) job().log("Time per phase");
+}
+
+
+void PerfStats::logAtExit(bool enable) {
+	g_logAtExit = enable;
+	if (enable && !g_atExitRegistered) { atexit(logJobTotals); g_atExitRegistered = true; }
+}
+
+
+PerfStats::Scope::Scope(PerfStats &stats)
+	: m_previous(t_currentStats)
+	{ t_currentStats = &stats; }
+
+
+PerfStats::Scope::~Scope() { t_currentStats = m_previous; }
+
+
+double PerfTimer::stop() {
+	double seconds = PerfStats::now() - m_start;
+	if (m_running) {
+		m_running = false;
+		PerfStats::record(m_phase, seconds);
+	}
+	return seconds;
+}
+
+
+} // namespace froast
@@ -0,0 +1,141 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+
+#ifndef FROAST_PERFSTATS_H
+#define FROAST_PERFSTATS_H
+
+#include <map>
+#include <string>
+
+#include <Rtypes.h>
+#include <TString.h>
+
+#include "JSONWriter.h"
+
+
+namespace froast {
+
+
+///	@brief	Accumulated wall-clock time of named processing phases
+///
+///	Phases are named "<operation>.<phase>", e.g. "mapSingle.open", or
+///	"<operation>.<mapper>.<phase>" for per-mapper totals. PerfTimer adds
+///	to the process-wide totals (job()) and to the record made current for
+///	the calling thread by a Scope, usually one record per output file.
+///	Such a per-file record is stored in its output file as "froast.perf",
+///	a TObjString holding a JSON object of the form
+///	{"mapSingle.open": {"seconds": 0.25, "calls": 1}, ...}.
+///
+///	Settings:
+///	- "froast.perf.print": Log the process-wide totals at exit (default: false)
+
+class PerfStats {
+public:
+	struct Total {
+		double seconds;
+		Long64_t calls;
+		Total(): seconds(0), calls(0) {}
+	};
+
+	typedef std::map<std::string, Total> Totals;
+
+protected:
+	Totals m_totals;
+
+	static void logJobTotals();
+
+public:
+	const Totals& totals() const { return m_totals; }
+
+	///	@brief	Add time to a phase
+	void add(const std::string &phase, double seconds, Long64_t calls = 1);
+
+	///	@brief	Seconds accumulated for a phase, 0 if unknown
+	double seconds(const std::string &phase) const;
+
+	void clear() { m_totals.clear(); }
+
+	void writeJSON(JSONWriter &json) const;
+
+	///	@brief	Log all totals, slowest phases first
+	void log(const char *title) const;
+
+	///	@brief	Write the totals as JSON into the current directory
+	void writeToGDirectory(const TString &name = "froast.perf") const;
+
+	///	@brief	Monotonic time in seconds
+	static double now();
+
+	///	@brief	Add time to the process-wide totals and the current record
+	static void record(const std::string &phase, double seconds);
+
+	///	@brief	Copy of the process-wide totals (thread-safe)
+	static PerfStats job();
+
+	///	@brief	Record of the current thread, 0 if there is none
+	static PerfStats* current();
+
+	///	@brief	Log the process-wide totals at exit
+	static void logAtExit(bool enable);
+
+	///	@brief	Makes a record current for this thread
+	class Scope {
+	protected:
+		PerfStats *m_previous;
+
+	private:
+		Scope(const Scope &other);
+		Scope& operator=(const Scope &other);
+
+	public:
+		Scope(PerfStats &stats);
+		~Scope();
+	};
+};
+
+
+///	@brief	Scoped timer of a processing phase, see PerfStats
+///
+///	Records the time from construction until stop() or destruction, so
+///	phases left by an exception are counted as well.
+
+class PerfTimer {
+protected:
+	std::string m_phase;
+	double m_start;
+	bool m_running;
+
+private:
+	PerfTimer(const PerfTimer &other);
+	PerfTimer& operator=(const PerfTimer &other);
+
+public:
+	///	@brief	Stop the timer and record the phase (only once)
+	///	@return	Seconds since construction
+	double stop();
+
+	PerfTimer(const std::string &phase): m_phase(phase), m_start(PerfStats::now()), m_running(true) {}
+	~PerfTimer() { stop(); }
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_PERFSTATS_H
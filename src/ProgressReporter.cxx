@@ -0,0 +1,209 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#include "ProgressReporter.h"
+
+#include <algorithm>
+
+#include <TChain.h>
+#include <TFile.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+
+#include "logging.h"
+#include "PerfStats.h"
+#include "Settings.h"
+
+
+using namespace std;
+
+
+namespace froast {
+
+
+namespace {
+
+Setting<double> s_progressInterval("froast.progress.interval", 10.0);
+Setting<double> s_progressSlowFactor("froast.progress.slow.factor", 3.0);
+
+TString formatDuration(double seconds) {
+	long s = long(seconds + 0.5);
+	if (s >= 3600) return TString::Format("%ldh%02ldm%02lds", s / 3600, (s / 60) % 60, s % 60);
+	else if (s >= 60) return TString::Format("%ldm%02lds", s / 60, s % 60);
+	else return TString::Format("%lds", s);
+}
+
+} // namespace
+
+
+void ProgressReporter::check() {
+	double t = PerfStats::now();
+	Long64_t done = m_entries - m_lastCheckEntries;
+	m_bytes += double(done) * m_bytesPerEntry;
+
+	// Aim for about ten clock reads per second
+	double dt = t - m_lastCheck;
+	if (dt > 0) m_checkEvery = std::max(Long64_t(1), std::min(Long64_t(1000000), Long64_t(0.1 * double(done) / dt)));
+	else m_checkEvery = std::min(Long64_t(1000000), 2 * m_checkEvery);
+	m_lastCheck = t;
+	m_lastCheckEntries = m_entries;
+	m_nextCheck = m_entries + m_checkEvery;
+
+	if ((m_interval > 0) && (t - m_lastReport >= m_interval)) report(t);
+}
+
+
+void ProgressReporter::report(double time) {
+	double dt = std::max(time - m_lastReport, 1e-6);
+	double rate = double(m_entries - m_lastReportEntries) / dt;
+	double mbRate = (m_bytes - m_lastReportBytes) / dt / (1024. * 1024.);
+
+	if (m_total > 0) {
+		double elapsed = std::max(time - m_start, 1e-6);
+		double fraction = std::min(1., double(m_entries) / double(m_total));
+		double remaining = double(std::max(Long64_t(0), m_total - m_entries)) / (double(m_entries) / elapsed);
+		log_info("%s: %lld of %lld entries (%.1f%%), %.0f entries/s, %.1f MB/s, ETA %s",
+			m_what.Data(), (long long) m_entries, (long long) m_total, 100. * fraction,
+			rate, mbRate, (m_entries > 0) ? formatDuration(remaining).Data() : "unknown");
+	} else {
+		log_info("%s: %lld entries, %.0f entries/s, %.1f MB/s",
+			m_what.Data(), (long long) m_entries, rate, mbRate);
+	}
+
+	m_lastReport = time;
+	m_lastReportEntries = m_entries;
+	m_lastReportBytes = m_bytes;
+}
+
+
+void ProgressReporter::fileEnd(double time) {
+	if (m_fileName.Length() == 0) return;
+	double fileTime = time - m_fileStart;
+	Long64_t fileEntries = m_entries - m_fileEntries;
+	double fileRate = double(fileEntries) / std::max(fileTime, 1e-6);
+	log_info("%s: file \"%s\" done, %lld entries in %.1f s (%.0f entries/s)",
+		m_what.Data(), m_fileName.Data(), (long long) fileEntries, fileTime, fileRate);
+
+	// Compare with the average of the previous files, ignoring short ones
+	if ((m_filesTime > 0) && (fileTime >= 1.0)) {
+		double averageRate = double(m_filesEntries) / m_filesTime;
+		if (fileRate * m_slowFactor < averageRate) {
+			log_warn("%s: slow input file \"%s\", %.0f entries/s, average %.0f entries/s",
+				m_what.Data(), m_fileName.Data(), fileRate, averageRate);
+		}
+	}
+	m_filesTime += fileTime;
+	m_filesEntries += fileEntries;
+	m_fileName = "";
+}
+
+
+void ProgressReporter::begin(const TString &what, Long64_t totalEntries) {
+	m_what = what;
+	m_total = totalEntries;
+	m_interval = s_progressInterval;
+	m_slowFactor = s_progressSlowFactor;
+
+	m_start = PerfStats::now();
+	m_entries = 0;
+	m_bytes = 0;
+
+	m_checkEvery = 100;
+	m_nextCheck = m_checkEvery;
+	m_lastCheck = m_start;
+	m_lastCheckEntries = 0;
+
+	m_lastReport = m_start;
+	m_lastReportEntries = 0;
+	m_lastReportBytes = 0;
+
+	m_fileName = "";
+	m_fileStart = m_start;
+	m_fileEntries = 0;
+	m_bytesPerEntry = 0;
+	m_filesTime = 0;
+	m_filesEntries = 0;
+}
+
+
+void ProgressReporter::file(TTree *tree) {
+	double t = PerfStats::now();
+	m_bytes += double(m_entries - m_lastCheckEntries) * m_bytesPerEntry;
+	m_lastCheckEntries = m_entries;
+	fileEnd(t);
+
+	TTree *current = tree->GetTree();
+	TFile *file = (current != 0) ? current->GetCurrentFile() : 0;
+	m_fileName = (file != 0) ? file->GetName() : ((current != 0) ? current->GetName() : "unknown");
+	m_fileStart = t;
+	m_fileEntries = m_entries;
+
+	m_bytesPerEntry = 0;
+	if ((current != 0) && (current->GetEntries() > 0)) {
+		double totBytes = 0;
+		TObjArray *branches = current->GetListOfBranches();
+		for (Int_t i = 0; i < branches->GetEntriesFast(); ++i) {
+			TBranch *branch = dynamic_cast<TBranch*>(branches->At(i));
+			if ((branch != 0) && current->GetBranchStatus(branch->GetName()))
+				totBytes += double(branch->GetTotBytes("*"));
+		}
+		m_bytesPerEntry = totBytes / double(current->GetEntries());
+	}
+}
+
+
+void ProgressReporter::end() {
+	double t = PerfStats::now();
+	m_bytes += double(m_entries - m_lastCheckEntries) * m_bytesPerEntry;
+	m_lastCheckEntries = m_entries;
+	fileEnd(t);
+	double elapsed = std::max(t - m_start, 1e-6);
+	log_info("%s: %lld entries in %s, %.0f entries/s, %.1f MB/s",
+		m_what.Data(), (long long) m_entries, formatDuration(elapsed).Data(),
+		double(m_entries) / elapsed, m_bytes / elapsed / (1024. * 1024.));
+}
+
+
+Long64_t ProgressReporter::totalEntries(TTree *tree) {
+	// A TChain only knows its total after opening all files
+	Long64_t n = tree->GetEntriesFast();
+	if ((dynamic_cast<TChain*>(tree) != 0) && (n >= TChain::kBigNumber)) return -1;
+	return n;
+}
+
+
+Long64_t ProgressReporter::totalEntries(TTree *tree, Long64_t nEntries, Long64_t startEntry) {
+	Long64_t total = totalEntries(tree);
+	if (total >= 0) total = std::max(Long64_t(0), total - startEntry);
+	if ((nEntries >= 0) && ((total < 0) || (nEntries < total))) total = nEntries;
+	return total;
+}
+
+
+ProgressReporter::ProgressReporter()
+	: m_total(-1), m_interval(0), m_slowFactor(0), m_start(0), m_entries(0), m_bytes(0),
+	  m_nextCheck(100), m_checkEvery(100), m_lastCheck(0), m_lastCheckEntries(0),
+	  m_lastReport(0), m_lastReportEntries(0), m_lastReportBytes(0),
+	  m_fileStart(0), m_fileEntries(0), m_bytesPerEntry(0), m_filesTime(0), m_filesEntries(0)
+{}
+
+
+ProgressReporter::~ProgressReporter() {}
+
+
+} // namespace froast
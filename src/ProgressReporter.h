@@ -0,0 +1,112 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_PROGRESSREPORTER_H
+#define FROAST_PROGRESSREPORTER_H
+
+#include <Rtypes.h>
+#include <TString.h>
+#include <TTree.h>
+
+
+namespace froast {
+
+
+///	@brief	Time-based progress reports for event loops
+///
+///	Reports entries/s, decompressed MB/s (estimated from the total size
+///	of the active branches), the percentage of the total entries and the
+///	ETA, plus the time spent on each input file. Files processed much
+///	slower than the average of the previous ones are flagged.
+///
+///	The clock is only read every few entries, adapted to the entry rate,
+///	so entry() is cheap enough to call for every entry.
+///
+///	Settings:
+///	- "froast.progress.interval": Seconds between reports (default: 10,
+///	  0 to disable reports)
+///	- "froast.progress.slow.factor": Flag input files with an entry rate
+///	  this many times below average (default: 3)
+
+class ProgressReporter {
+protected:
+	TString m_what;
+	Long64_t m_total;
+	double m_interval;
+	double m_slowFactor;
+
+	double m_start;
+	Long64_t m_entries;
+	double m_bytes;
+
+	Long64_t m_nextCheck;
+	Long64_t m_checkEvery;
+	double m_lastCheck;
+	Long64_t m_lastCheckEntries;
+
+	double m_lastReport;
+	Long64_t m_lastReportEntries;
+	double m_lastReportBytes;
+
+	TString m_fileName;
+	double m_fileStart;
+	Long64_t m_fileEntries;
+	double m_bytesPerEntry;
+	double m_filesTime;
+	Long64_t m_filesEntries;
+
+	void check();
+	void report(double time);
+	void fileEnd(double time);
+
+public:
+	///	@brief	Start a loop
+	///	@param	what	Description of the loop for the reports, e.g. "Mapping"
+	///	@param	totalEntries	Total number of entries, -1 if unknown
+	void begin(const TString &what, Long64_t totalEntries = -1);
+
+	///	@brief	Signal that the loop switched to the next input file
+	///	@param	tree	Tree or chain (the current tree of a chain is used)
+	void file(TTree *tree);
+
+	///	@brief	Count one entry
+	void entry() { if (++m_entries >= m_nextCheck) check(); }
+
+	///	@brief	End the loop and log a summary
+	void end();
+
+	Long64_t entries() const { return m_entries; }
+
+	///	@brief	Total entries of a tree or chain, -1 if unknown
+	///
+	///	Doesn't force a TChain to open all its files.
+	static Long64_t totalEntries(TTree *tree);
+
+	///	@brief	Number of entries of a tree or chain in a range, -1 if unknown
+	///	@param	nEntries	Maximum number of entries, negative for no limit
+	static Long64_t totalEntries(TTree *tree, Long64_t nEntries, Long64_t startEntry);
+
+	ProgressReporter();
+	virtual ~ProgressReporter();
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_PROGRESSREPORTER_H
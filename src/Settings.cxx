@@ -18,6 +18,7 @@
 #include "Settings.h"
 
 #include <string>
+#include <vector>
 #include <set>
 #include <sstream>
 #include <fstream>
@@ -28,6 +29,9 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
+
+#include <pthread.h>
 
 #include <TObjString.h>
 #include <TObjArray.h>
@@ -45,6 +49,199 @@ ClassImp(froast::Settings)
 using namespace std;
 
 
+namespace {
+
+
+using namespace froast;
+
+
+// Streams parsed JSON directly into a TEnv, nested keys joined by ".".
+// Arrays are stored in their JSON form.
+class SettingsJSONReader: public JSONHandler {
+protected:
+	Settings *m_settings;
+	EEnvLevel m_level;
+	TString m_prefix;
+	vector<Ssiz_t> m_prefixLength;
+	TString m_key;
+	int m_depth;
+	JSONWriter m_array;
+	int m_arrayDepth;
+
+	TString fullKey() const { return (m_prefix.Length() == 0) ? m_key : m_prefix + "." + m_key; }
+
+	void set(const TString &value) {
+		if (m_depth == 0) throw runtime_error("JSON settings must be an object");
+		m_settings->set(fullKey(), value.Data(), m_level);
+	}
+
+public:
+	virtual void beginObject() {
+		if (m_arrayDepth > 0) { m_array.beginObject(); return; }
+		if (m_depth++ == 0) return;
+		m_prefixLength.push_back(m_prefix.Length());
+		m_prefix = fullKey();
+	}
+
+	virtual void endObject() {
+		if (m_arrayDepth > 0) { m_array.endObject(); return; }
+		if (--m_depth == 0) return;
+		m_prefix.Resize(m_prefixLength.back());
+		m_prefixLength.pop_back();
+	}
+
+	virtual void beginArray() {
+		if (m_arrayDepth++ == 0) {
+			if (m_depth == 0) throw runtime_error("JSON settings must be an object");
+			m_array.clear();
+		}
+		m_array.beginArray();
+	}
+
+	virtual void endArray() {
+		m_array.endArray();
+		if (--m_arrayDepth == 0) set(m_array.str().c_str());
+	}
+
+	virtual void key(const char *name, size_t length) {
+		if (m_arrayDepth > 0) m_array.key(name, length);
+		else m_key = TString(name, length);
+	}
+
+	virtual void stringValue(const char *value, size_t length) {
+		if (m_arrayDepth > 0) m_array.stringValue(value, length);
+		else set(TString(value, length));
+	}
+
+	virtual void intValue(int64_t value) {
+		if (m_arrayDepth > 0) m_array.intValue(value);
+		else set(JSON::numberToString(value).c_str());
+	}
+
+	virtual void floatValue(double value) {
+		if (m_arrayDepth > 0) m_array.floatValue(value);
+		else set(JSON::numberToString(value).c_str());
+	}
+
+	virtual void boolValue(bool value) {
+		if (m_arrayDepth > 0) m_array.boolValue(value);
+		else set(value ? "true" : "false");
+	}
+
+	virtual void nullValue() {
+		if (m_arrayDepth > 0) m_array.nullValue();
+		else set("null");
+	}
+
+	SettingsJSONReader(Settings *settings, EEnvLevel level)
+		: m_settings(settings), m_level(level), m_depth(0), m_array(256), m_arrayDepth(0) {}
+};
+
+
+// Settings context of the current thread, 0 means global
+__thread Settings *t_currentSettings = 0;
+
+
+// Setting<T> caches of one thread, one per context, most recently used first
+struct SettingsCache {
+	uint64_t context;
+	vector<Settings::CacheSlot> slots;
+	SettingsCache *next;
+
+	SettingsCache(uint64_t id, SettingsCache *nextCache): context(id), next(nextCache) {}
+
+	~SettingsCache() {
+		for (size_t i = 0; i < slots.size(); ++i)
+			if (slots[i].value != 0) slots[i].destroy(slots[i].value);
+	}
+};
+
+__thread SettingsCache *t_settingsCache = 0;
+
+pthread_key_t g_settingsCacheKey;
+pthread_once_t g_settingsCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+void deleteSettingsCaches(void *caches) {
+	SettingsCache *cache = static_cast<SettingsCache*>(caches);
+	while (cache != 0) {
+		SettingsCache *next = cache->next;
+		delete cache;
+		cache = next;
+	}
+}
+
+void createSettingsCacheKey() { pthread_key_create(&g_settingsCacheKey, deleteSettingsCaches); }
+
+// Find the cache of a context and move it to the front of the list,
+// optionally creating it. Returns 0 if not found and not created.
+SettingsCache* threadCache(uint64_t context, bool create) {
+	SettingsCache *previous = 0;
+	SettingsCache *cache = t_settingsCache;
+	while ((cache != 0) && (cache->context != context)) { previous = cache; cache = cache->next; }
+	if (cache == 0) {
+		if (!create) return 0;
+		cache = new SettingsCache(context, t_settingsCache);
+	} else if (previous != 0) {
+		previous->next = cache->next;
+		cache->next = t_settingsCache;
+	} else return cache;
+	t_settingsCache = cache;
+	pthread_once(&g_settingsCacheKeyOnce, createSettingsCacheKey);
+	pthread_setspecific(g_settingsCacheKey, cache);
+	return cache;
+}
+
+
+// Setting<T> handles, for Settings::saveDefaults(). Never deleted, as
+// static handles may unregister after other statics are gone.
+pthread_mutex_t g_handlesMutex = PTHREAD_MUTEX_INITIALIZER;
+vector<const Settings::Handle*> *g_handles = 0;
+
+
+// Orders setting names component-wise ("." sorts before any other
+// character), so that all names with a common prefix are adjacent.
+bool settingNameLess(const TEnvRec *a, const TEnvRec *b) {
+	const unsigned char *x = (const unsigned char*) a->GetName();
+	const unsigned char *y = (const unsigned char*) b->GetName();
+	while ((*x != 0) && (*x == *y)) { ++x; ++y; }
+	unsigned cx = (*x == '.') ? 1 : (*x == 0) ? 0 : unsigned(*x) + 1;
+	unsigned cy = (*y == '.') ? 1 : (*y == 0) ? 0 : unsigned(*y) + 1;
+	return cx < cy;
+}
+
+
+// Writes a setting value, typed like in Settings::exportNested
+void writeSettingValue(JSONWriter &json, const char *rawValue) {
+	const char *begin = rawValue;
+	const char *end = rawValue + strlen(rawValue);
+	while ((begin < end) && isspace((unsigned char)(*begin))) ++begin;
+	while ((end > begin) && isspace((unsigned char)(*(end-1)))) --end;
+	size_t length = end - begin;
+
+	if (length == 0) { json.nullValue(); return; }
+
+	string value(begin, length);
+	const char *valueCString = value.c_str();
+	char *numEnd;
+	double doubleValue = strtod(valueCString, &numEnd);
+	if (numEnd == valueCString + length) {
+		int32_t intValue = int32_t(doubleValue);
+		if ((double(intValue) != doubleValue) || (value.find_first_of(".eE") != string::npos))
+			json.floatValue(doubleValue);
+		else json.intValue(intValue);
+	} else if (value == "true") {
+		json.boolValue(true);
+	} else if (value == "false") {
+		json.boolValue(false);
+	} else {
+		json.stringValue(begin, length);
+	}
+}
+
+
+} // namespace
+
+
 namespace froast {
 
 
@@ -84,10 +281,28 @@ Param::~Param() {}
 
 
 Settings Settings::m_global(gEnv, false);
+
+size_t Settings::m_cacheSlots = 0;
+
+uint64_t Settings::m_contexts = 0;
+
+
+Settings& Settings::current() {
+	Settings *settings = t_currentSettings;
+	return (settings != 0) ? *settings : m_global;
+}
+
+
+Settings::Scope::Scope(Settings &settings)
+	: m_previous(t_currentSettings)
+	{ t_currentSettings = &settings; }
+
+
+Settings::Scope::~Scope() { t_currentSettings = m_previous; }
 	
 
 bool Settings::defined(const char* name) {
-	return tenv()->Defined(name);
+	return m_env->Defined(name);
 }
 
 
@@ -141,13 +356,13 @@ bool Settings::operator()(const char* name, bool dflt, bool saveDflt) {
 	bool value = dflt;
 	bool saveValue = false;
 
-	if (tenv()->Defined(name)) {
-		const char* strVal =  tenv()->GetValue(name, "");
+	if (m_env->Defined(name)) {
+		const char* strVal =  m_env->GetValue(name, "");
 		if (strcmp(strVal, "true") == 0) value = true;
 		else if (strcmp(strVal, "false") == 0) value = false;
-		else value = ( tenv()->GetValue(name, int32_t(dflt)) ) > 0 ? true : false;
+		else value = ( m_env->GetValue(name, int32_t(dflt)) ) > 0 ? true : false;
 	}
-	else saveValue = true;
+	else saveValue = saveDflt;
 
 	if (saveValue) set(name, value, kEnvLocal);
 	return value;
@@ -155,49 +370,49 @@ bool Settings::operator()(const char* name, bool dflt, bool saveDflt) {
 
 
 int32_t Settings::operator()(const char* name, int32_t dflt, bool saveDflt) {
-	bool saveValue = saveDflt && !tenv()->Defined(name);
-	int32_t value = tenv()->GetValue(name, dflt);
+	bool saveValue = saveDflt && !m_env->Defined(name);
+	int32_t value = m_env->GetValue(name, dflt);
 	if (saveValue) set(name, value, kEnvLocal);
 	return value;
 }
 
 
 double Settings::operator()(const char* name, double dflt, bool saveDflt) {
-	bool saveValue = saveDflt && !tenv()->Defined(name);
-	double value = tenv()->GetValue(name, dflt);
+	bool saveValue = saveDflt && !m_env->Defined(name);
+	double value = m_env->GetValue(name, dflt);
 	if (saveValue) set(name, value, kEnvLocal);
 	return value;
 }
 
 
 const char* Settings::operator()(const char* name, const char* dflt, bool saveDflt) {
-	bool saveValue = saveDflt && !tenv()->Defined(name);
-	const char* value = tenv()->GetValue(name, dflt);
+	bool saveValue = saveDflt && !m_env->Defined(name);
+	const char* value = m_env->GetValue(name, dflt);
 	if (saveValue) set(name, value, kEnvLocal);
 	return value;
 }
 
 
 bool Settings::set(const char* name, bool value, EEnvLevel level) {
-	tenv()->SetValue(name, value ? "true" : "false", level);
+	setValue(name, value ? "true" : "false", level);
 	return value;
 }
 
 
 int32_t Settings::set(const char* name, int32_t value, EEnvLevel level) {
-	tenv()->SetValue(name, Form("%ld", (long int)(value)), level);
+	setValue(name, Form("%ld", (long int)(value)), level);
 	return value;
 }
 
 
 double Settings::set(const char* name, double value, EEnvLevel level) {
-	tenv()->SetValue(name, Form("%g", value), level);
+	setValue(name, Form("%g", value), level);
 	return value;
 }
 
 
 const char* Settings::set(const char* name, const char* value, EEnvLevel level) {
-	tenv()->SetValue(name, value, level);
+	setValue(name, value, level);
 	return value;
 }
 
@@ -278,9 +493,9 @@ void Settings::importNested(const THashList *nested, EEnvLevel level, const TStr
 			importNested(obj, level, fullKey);
 		} else if (dynamic_cast<const TObjString*>(value)) {
 			const TObjString *s = dynamic_cast<const TObjString*>(value);
-			tenv()->SetValue(fullKey, s->GetString(), level);
+			setValue(fullKey, s->GetString(), level);
 		} else {
-			tenv()->SetValue(fullKey, JSON::toString(value).c_str(), level);
+			setValue(fullKey, JSON::toString(value).c_str(), level);
 		}
 	}
 }
@@ -295,19 +510,72 @@ void Settings::write(const TString &fileName, EEnvLevel minLevel) const {
 
 
 void Settings::read(const TString &fileName, EEnvLevel level) {
-	tenv()->ReadFile(fileName.Data(), level);
+	if (m_layers.empty()) {
+		tenv()->ReadFile(fileName.Data(), level);
+	} else {
+		// Read via a temporary TEnv, so the changes can be recorded
+		TEnv input;
+		input.ReadFile(fileName.Data(), level);
+		TIter next(input.GetTable(), kIterForward);
+		while (TEnvRec *rec = dynamic_cast<TEnvRec*>(next()))
+			setValue(rec->GetName(), rec->GetValue(), rec->GetLevel());
+	}
 }
 
 
 void Settings::writeJSON(std::ostream &out, EEnvLevel minLevel) const {
-	auto_ptr<THashList> nested(exportNested(minLevel));
-	JSON::write(out, &(*nested)) << endl;
+	JSONWriter json;
+	writeJSON(json, minLevel);
+	json.writeTo(out) << endl;
+}
+
+
+void Settings::writeJSON(JSONWriter &json, EEnvLevel minLevel) const {
+	vector<const TEnvRec*> records;
+	const THashList *settings = table();
+	if (settings != 0) {
+		records.reserve(settings->GetSize());
+		TIter next(settings, kIterForward);
+		const TEnvRec *record;
+		while ( (record = dynamic_cast<const TEnvRec*>(next())) )
+			if (record->GetLevel() >= minLevel) records.push_back(record);
+	}
+	sort(records.begin(), records.end(), settingNameLess);
+
+	// Walk the sorted names once, closing and opening nested objects
+	// where the name prefix changes
+	json.beginObject();
+	vector<string> open;
+	for (size_t i = 0; i < records.size(); ++i) {
+		const char *name = records[i]->GetName();
+		vector<string> parts;
+		for (const char *p = name; ; ++p) {
+			const char *start = p;
+			while ((*p != 0) && (*p != '.')) ++p;
+			if (p > start) parts.push_back(string(start, p - start));
+			if (*p == 0) break;
+		}
+		if (parts.empty()) continue;
+
+		size_t common = 0;
+		while ((common < open.size()) && (common < parts.size() - 1) && (open[common] == parts[common])) ++common;
+		while (open.size() > common) { json.endObject(); open.pop_back(); }
+		for (size_t j = common; j < parts.size() - 1; ++j) {
+			json.key(parts[j].data(), parts[j].size());
+			json.beginObject();
+			open.push_back(parts[j]);
+		}
+		json.key(parts.back().data(), parts.back().size());
+		writeSettingValue(json, records[i]->GetValue());
+	}
+	while (!open.empty()) { json.endObject(); open.pop_back(); }
+	json.endObject();
 }
 
 
 void Settings::readJSON(std::istream &in, EEnvLevel level) {
-	auto_ptr<THashList> nested(JSON::read(in));
-	importNested(&(*nested), level);
+	SettingsJSONReader reader(this, level);
+	JSON::parse(in, reader);
 }
 
 
@@ -326,33 +594,110 @@ std::ostream& Settings::write(std::ostream &out, EEnvLevel minLevel) const {
 
 
 void Settings::read(TDirectory *tdir, const TString &name) {
-	THashList *settings; tdir->GetObject(name.Data(), settings);
-	if (settings == 0 && this!=&m_global)
-		throw runtime_error(string("No settings found in \"") + tdir->GetName() + "\"");
-	TIter next(settings, kIterForward);
-	while (TEnvRec *record = dynamic_cast<TEnvRec*>(next()))
-		if (!tenv()->Defined(record->GetName())) // avoid stupid verbosity
-			tenv()->SetValue(record->GetName(), record->GetValue(), record->GetLevel());
+	auto_ptr<TObject> stored(tdir->Get(name.Data()));
+	// Input files without stored settings are fine, in any context
+	if (stored.get() == 0) return;
+
+	if (TObjString *blob = dynamic_cast<TObjString*>(stored.get())) {
+		// Compact format, see writeToGDirectory()
+		const char *p = blob->GetString().Data();
+		const char *end = p + blob->GetString().Length();
+		TString recName, value;
+		while (p < end) {
+			const char *lineEnd = p;
+			while ((lineEnd < end) && (*lineEnd != '\n')) ++lineEnd;
+			const char *nameEnd = p;
+			while ((nameEnd < lineEnd) && (*nameEnd != '\t')) ++nameEnd;
+			const char *levelEnd = (nameEnd < lineEnd) ? nameEnd + 1 : lineEnd;
+			while ((levelEnd < lineEnd) && (*levelEnd != '\t')) ++levelEnd;
+			if (levelEnd >= lineEnd) throw runtime_error(string("Invalid settings record in \"") + tdir->GetName() + "\"");
+
+			recName = TString(p, nameEnd - p);
+			EEnvLevel level = EEnvLevel(atoi(TString(nameEnd + 1, levelEnd - nameEnd - 1).Data()));
+			value = "";
+			for (const char *c = levelEnd + 1; c < lineEnd; ++c) {
+				if ((*c == '\\') && (c + 1 < lineEnd)) {
+					++c;
+					value.Append((*c == 'n') ? '\n' : (*c == 't') ? '\t' : *c);
+				} else value.Append(*c);
+			}
+			if (!m_env->Defined(recName.Data())) // avoid stupid verbosity
+				setValue(recName.Data(), value.Data(), level);
+			p = lineEnd + 1;
+		}
+	} else if (THashList *settings = dynamic_cast<THashList*>(stored.get())) {
+		// One TEnvRec per setting, as written by older versions
+		TIter next(settings, kIterForward);
+		while (TEnvRec *record = dynamic_cast<TEnvRec*>(next()))
+			if (!m_env->Defined(record->GetName())) // avoid stupid verbosity
+				setValue(record->GetName(), record->GetValue(), record->GetLevel());
+		settings->Delete();
+	} else {
+		throw runtime_error(string("Invalid settings object in \"") + tdir->GetName() + "\"");
+	}
+}
+
+
+bool Settings::storedHash(TDirectory *tdir, uint64_t &hash, const TString &name) {
+	TObjString *stored;
+	tdir->GetObject((name + ".hash").Data(), stored);
+	if (stored == 0) return false;
+	char *end = 0;
+	hash = uint64_t(strtoull(stored->GetString().Data(), &end, 16));
+	bool valid = (end != 0) && (*end == 0) && (stored->GetString().Length() > 0);
+	delete stored;
+	return valid;
+}
+
+
+uint64_t Settings::hash(const char *data, size_t size) {
+	// 64 bit FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; ++i) {
+		h ^= (unsigned char)(data[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
 }
 
 
 void Settings::writeToGDirectory(const TString &name, EEnvLevel minLevel) const {
-	THashList settingsOut;
-	settingsOut.SetName(name.Data());
-	
+	// All records in one sorted, line-based string ("name<TAB>level<TAB>value"),
+	// plus a hash of it, so readers can skip identical settings cheaply
+	vector<const TEnvRec*> records;
 	const THashList *settings = table();
 	assert (settings != 0);
+	records.reserve(settings->GetSize());
 	TIter next(settings, kIterForward);
-	while (TEnvRec* record = dynamic_cast<TEnvRec*>(next())) {
-		TString name(record->GetName());
-		if ((record->GetLevel() >= minLevel) && !name.Contains("Path"))
-			settingsOut.AddLast(record->Clone());
+	while (const TEnvRec* record = dynamic_cast<const TEnvRec*>(next())) {
+		TString recName(record->GetName());
+		if ((record->GetLevel() >= minLevel) && !recName.Contains("Path"))
+			records.push_back(record);
 	}
-	next=TIter(tenv()->GetTable(), kIterForward);
-	while (TEnvRec *record = dynamic_cast<TEnvRec*>(next()))
-		if (record->GetLevel() >= minLevel)
-			settingsOut.AddLast(record->Clone());
-	settingsOut.Write(name.Data(), TObject::kSingleKey);
+	sort(records.begin(), records.end(), settingNameLess);
+
+	string blob;
+	for (size_t i = 0; i < records.size(); ++i) {
+		blob += records[i]->GetName();
+		blob += '\t';
+		blob += TString::Format("%i", int(records[i]->GetLevel())).Data();
+		blob += '\t';
+		for (const char *c = records[i]->GetValue(); *c != 0; ++c) {
+			switch (*c) {
+				case '\\': blob += "\\\\"; break;
+				case '\n': blob += "\\n"; break;
+				case '\t': blob += "\\t"; break;
+				default: blob += *c;
+			}
+		}
+		blob += '\n';
+	}
+
+	TObjString settingsOut(blob.c_str());
+	settingsOut.Write(name.Data(), TObject::kOverwrite);
+	// As a string, numeric TParameters would be summed up by hadd
+	TObjString hashOut(TString::Format("%016llx", (unsigned long long)hash(blob.data(), blob.size())).Data());
+	hashOut.Write((name + ".hash").Data(), TObject::kOverwrite);
 }
 
 
@@ -386,19 +731,140 @@ std::string Settings::toString() const {
 
 
 void Settings::clear() {
+	if (!m_layers.empty()) {
+		TIter next(m_env->GetTable(), kIterForward);
+		while (TEnvRec *rec = dynamic_cast<TEnvRec*>(next())) record(rec->GetName());
+	}
 	table()->Clear();
 }
 
 
+void Settings::record(const char* name) {
+	TEnvRec *rec = m_env->Lookup(name);
+	Change change;
+	change.name = name;
+	change.existed = (rec != 0);
+	if (rec != 0) {
+		change.value = rec->GetValue();
+		change.level = rec->GetLevel();
+	} else change.level = kEnvLocal;
+	m_changes.push_back(change);
+}
+
+
+void Settings::setValue(const char* name, const char* value, EEnvLevel level) {
+	if (!m_layers.empty()) record(name);
+	tenv()->SetValue(name, value, level);
+}
+
+
+void Settings::undo(const Change &change) {
+	// Replace the record instead of changing it, TEnv ignores changes of
+	// existing records on the same level
+	THashList *records = m_env->GetTable();
+	TObject *current = records->FindObject(change.name.Data());
+	if (current != 0) {
+		records->Remove(current);
+		delete current;
+	}
+	if (change.existed) m_env->SetValue(change.name.Data(), change.value.Data(), change.level);
+}
+
+
+void Settings::beginLayer() {
+	m_layers.push_back(m_changes.size());
+}
+
+
+void Settings::restoreLayer() {
+	if (m_layers.empty()) throw logic_error("No settings layer to restore");
+	size_t begin = m_layers.back();
+	if (m_changes.size() == begin) return;
+	changed();
+	while (m_changes.size() > begin) {
+		undo(m_changes.back());
+		m_changes.pop_back();
+	}
+}
+
+
+void Settings::endLayer(bool restore) {
+	if (m_layers.empty()) throw logic_error("No settings layer to end");
+	if (restore) restoreLayer();
+	m_layers.pop_back();
+	// Changes stay recorded as part of the enclosing layer, if any
+	if (m_layers.empty()) m_changes.clear();
+}
+
+
+Settings::CacheSlot& Settings::cacheSlot(size_t index) {
+	SettingsCache *cache = t_settingsCache;
+	if ((cache == 0) || (cache->context != m_id)) cache = threadCache(m_id, true);
+	if (index >= cache->slots.size())
+		cache->slots.resize(std::max(index + 1, __atomic_load_n(&m_cacheSlots, __ATOMIC_RELAXED)));
+	return cache->slots[index];
+}
+
+
+void Settings::registerHandle(const Handle *handle) {
+	pthread_mutex_lock(&g_handlesMutex);
+	if (g_handles == 0) g_handles = new vector<const Handle*>;
+	g_handles->push_back(handle);
+	pthread_mutex_unlock(&g_handlesMutex);
+}
+
+
+void Settings::unregisterHandle(const Handle *handle) {
+	pthread_mutex_lock(&g_handlesMutex);
+	if (g_handles != 0) {
+		vector<const Handle*>::iterator pos = find(g_handles->begin(), g_handles->end(), handle);
+		if (pos != g_handles->end()) g_handles->erase(pos);
+	}
+	pthread_mutex_unlock(&g_handlesMutex);
+}
+
+
+void Settings::saveDefaults() {
+	pthread_mutex_lock(&g_handlesMutex);
+	try {
+		if (g_handles != 0)
+			for (size_t i = 0; i < g_handles->size(); ++i) (*g_handles)[i]->saveDefault(*this);
+	} catch (...) {
+		pthread_mutex_unlock(&g_handlesMutex);
+		throw;
+	}
+	pthread_mutex_unlock(&g_handlesMutex);
+}
+
+
 Settings::Settings(TEnv* env, bool own)
-	: m_env(env), m_envOwned(own) {}
+	: m_env(env), m_envOwned(own), m_generation(0),
+	  m_id(__atomic_add_fetch(&m_contexts, 1, __ATOMIC_RELAXED)) {}
+
+
+Settings::Settings(const Settings &other)
+	: m_env(new TEnv), m_envOwned(true), m_generation(0),
+	  m_id(__atomic_add_fetch(&m_contexts, 1, __ATOMIC_RELAXED))
+{
+	TIter next(other.table(), kIterForward);
+	while (TEnvRec *rec = dynamic_cast<TEnvRec*>(next()))
+		m_env->SetValue(rec->GetName(), rec->GetValue(), rec->GetLevel());
+}
 
 
 Settings::Settings()
-	: m_env(new TEnv), m_envOwned(true) {}
+	: m_env(new TEnv), m_envOwned(true), m_generation(0),
+	  m_id(__atomic_add_fetch(&m_contexts, 1, __ATOMIC_RELAXED)) {}
 
 
 Settings::~Settings() {
+	// Caches of other threads are freed when these exit
+	SettingsCache *cache = threadCache(m_id, false);
+	if (cache != 0) {
+		t_settingsCache = cache->next;
+		pthread_setspecific(g_settingsCacheKey, t_settingsCache);
+		delete cache;
+	}
 	if (m_envOwned && (m_env !=0)) delete m_env;
 }
 
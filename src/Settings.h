@@ -27,6 +27,8 @@
 #include <THashList.h>
 #include <TDirectory.h>
 
+#include "JSONWriter.h"
+
 
 namespace froast {
 
@@ -56,15 +58,133 @@ public:
 
 
 class Settings {
+protected:
+	struct Change {
+		TString name;
+		TString value;
+		EEnvLevel level;
+		bool existed;
+	};
+
+public:
+	///	@brief	Per-context and per-thread cache entry of a Setting<T> handle
+	struct CacheSlot {
+		void *value;
+		void (*destroy)(void *value);
+		uint64_t generation;
+
+		CacheSlot(): value(0), destroy(0), generation(uint64_t(-1)) {}
+	};
+
+	///	@brief	Setting<T> handle, registered for saveDefaults()
+	class Handle {
+	public:
+		virtual void saveDefault(Settings &settings) const = 0;
+		virtual ~Handle() {}
+	};
+
 protected:
 	static Settings m_global;
+	static size_t m_cacheSlots;
+	static uint64_t m_contexts;
 
 	TEnv *m_env;
 	bool m_envOwned;
+	uint64_t m_generation;
+	uint64_t m_id;
+
+	std::vector<Change> m_changes;
+	std::vector<size_t> m_layers;
+
+	void record(const char* name);
+	void setValue(const char* name, const char* value, EEnvLevel level);
+	void undo(const Change &change);
+
+private:
+	Settings& operator=(const Settings &other);
 	
 public:
+	///	@brief	Settings layer, undoes all changes made within its scope
+	///
+	///	Changes are recorded relative to the enclosing layer, so a layer
+	///	can be restored repeatedly, e.g. after each input file.
+	class Layer {
+	protected:
+		Settings &m_settings;
+		bool m_restoreOnExit;
+
+	private:
+		Layer(const Layer &other);
+		Layer& operator=(const Layer &other);
+
+	public:
+		///	@brief	Undo all changes made since the layer was opened
+		void restore() { m_settings.restoreLayer(); }
+
+		Layer(Settings &settings, bool restoreOnExit = true)
+			: m_settings(settings), m_restoreOnExit(restoreOnExit) { m_settings.beginLayer(); }
+
+		~Layer() { m_settings.endLayer(m_restoreOnExit); }
+	};
+
+	///	@brief	Process-wide settings, backed by gEnv
 	static Settings &global() { return m_global; }
 
+	///	@brief	Settings context of the current thread
+	///
+	///	The innermost active Scope of this thread, or global() if there
+	///	is none. GSettings and Setting<T> resolve against this context.
+	static Settings &current();
+
+	///	@brief	Makes a Settings context current for this thread
+	///
+	///	Contexts are not synchronized: lookups via operator() and GSettings
+	///	save defaults, i.e. modify the context. To run several mappings
+	///	concurrently within one process, give each thread a context of its
+	///	own (e.g. a copy of global()) and make it current before creating
+	///	its selectors. Only Setting<T> reads don't modify the context.
+	class Scope {
+	protected:
+		Settings *m_previous;
+
+	private:
+		Scope(const Scope &other);
+		Scope& operator=(const Scope &other);
+
+	public:
+		Scope(Settings &settings);
+		~Scope();
+	};
+
+	///	@brief	Generation of these settings, changes whenever they are modified
+	///
+	///	Used by Setting<T> to detect stale cached values.
+	uint64_t generation() const { return __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE); }
+
+	///	@brief	Mark settings as changed
+	///
+	///	Called by all modifying member functions, and by the non-const
+	///	tenv() and table() accessors, since the caller may modify the TEnv.
+	void changed() { __atomic_add_fetch(&m_generation, 1, __ATOMIC_ACQ_REL); }
+
+	static size_t newCacheSlot() { return __atomic_fetch_add(&m_cacheSlots, 1, __ATOMIC_RELAXED); }
+
+	///	@brief	Cache entry of a Setting<T> handle for this context
+	///
+	///	Each thread has caches of its own, so reading through Setting<T>
+	///	doesn't write to anything shared with other threads.
+	CacheSlot& cacheSlot(size_t index);
+
+	static void registerHandle(const Handle *handle);
+	static void unregisterHandle(const Handle *handle);
+
+	///	@brief	Save the defaults of all Setting<T> handles constructed so far
+	///
+	///	Setting<T> reads don't save defaults, call this (on the thread
+	///	owning the context) before writing the settings to an output, so
+	///	they record all values used.
+	void saveDefaults();
+
 	bool defined(const char* name);
 
 	void getInstances(const TString &pattern, std::vector<int32_t> &instances) const;
@@ -80,9 +200,9 @@ public:
 	const char* set(const char* name, const char* value, EEnvLevel level = kEnvLocal);
 
 	const TEnv* tenv() const { return m_env; }
-	TEnv* tenv() { return m_env; }
-	const THashList* table() const { return tenv()->GetTable(); }
-	THashList* table() { return tenv()->GetTable(); }
+	TEnv* tenv() { changed(); return m_env; }
+	const THashList* table() const { return m_env->GetTable(); }
+	THashList* table() { changed(); return m_env->GetTable(); }
 
 	THashList* exportNested(EEnvLevel minLevel = kEnvLocal) const;
 	void importNested(const THashList *nested, EEnvLevel level = kEnvLocal, const TString &prefix = "");
@@ -91,21 +211,61 @@ public:
 	void read(const TString &fileName, EEnvLevel level = kEnvLocal);
 
 	void writeJSON(std::ostream &out, EEnvLevel minLevel = kEnvLocal) const;
+	void writeJSON(JSONWriter &json, EEnvLevel minLevel = kEnvLocal) const;
 	void readJSON(std::istream &in, EEnvLevel level = kEnvLocal);
 
 	std::ostream& write(std::ostream &out, EEnvLevel minLevel = kEnvLocal) const;
 
+	///	@brief	Read settings stored by writeToGDirectory
+	///
+	///	Accepts both the compact format and the THashList of TEnvRecs
+	///	written by older versions. Settings already defined are kept.
+	///	Does nothing if there are no stored settings.
 	void read(TDirectory *tdir, const TString &name = "settings");
+
+	///	@brief	Write the settings into the current directory
+	///
+	///	Written as a single sorted string of records ("name", TObjString)
+	///	plus its hash ("name.hash", TObjString with 16 hex digits). Existing
+	///	objects of the same names are overwritten.
 	void writeToGDirectory(const TString &name = "settings", EEnvLevel minLevel = kEnvLocal) const;
 
+	///	@brief	Get the hash of settings stored by writeToGDirectory
+	///
+	///	Returns false if there is none (e.g. written by an older version).
+	///	Equal hashes mean identical settings, so reading them can be skipped.
+	static bool storedHash(TDirectory *tdir, uint64_t &hash, const TString &name = "settings");
+
+	///	@brief	64 bit FNV-1a hash
+	static uint64_t hash(const char *data, size_t size);
+
 	void readAuto(const TString &fileName, EEnvLevel level = kEnvLocal);
 
 	std::string toString() const;
 	
 	void clear();
 
+	///	@brief	Open a new layer, see Layer
+	///
+	///	Only changes made through Settings are recorded, not changes made
+	///	directly to the TEnv. Undoing a layer takes time proportional to
+	///	the number of changes made within it, not to the number of settings.
+	void beginLayer();
+
+	///	@brief	Undo all changes made since the innermost beginLayer()
+	void restoreLayer();
+
+	///	@brief	Close the innermost layer, either undoing its changes or
+	///	keeping them as changes of the enclosing layer
+	void endLayer(bool restore = true);
+
+	size_t layers() const { return m_layers.size(); }
+
 	Settings(TEnv* env, bool own = false);
 
+	///	@brief	Create an independent context with a copy of all settings of other
+	Settings(const Settings &other);
+
 	Settings();
 	virtual ~Settings();
 };
@@ -114,18 +274,88 @@ public:
 
 class GSettings {
 public:
-	static void getInstances(const TString &pattern, std::vector<int32_t> &instances) { Settings::global().getInstances(pattern, instances); }
+	static void getInstances(const TString &pattern, std::vector<int32_t> &instances) { Settings::current().getInstances(pattern, instances); }
 
-	static bool get(const char* name, bool dflt, bool saveDflt = true) { return Settings::global()(name, dflt, saveDflt); }
-	static int32_t get(const char* name, int32_t dflt, bool saveDflt = true) { return Settings::global()(name, dflt, saveDflt); }
-	static double get(const char* name, double dflt, bool saveDflt = true) { return Settings::global()(name, dflt, saveDflt); }
-	static const char* get(const char* name, const char* dflt, bool saveDflt = true) { return Settings::global()(name, dflt, saveDflt); }
+	static bool get(const char* name, bool dflt, bool saveDflt = true) { return Settings::current()(name, dflt, saveDflt); }
+	static int32_t get(const char* name, int32_t dflt, bool saveDflt = true) { return Settings::current()(name, dflt, saveDflt); }
+	static double get(const char* name, double dflt, bool saveDflt = true) { return Settings::current()(name, dflt, saveDflt); }
+	static const char* get(const char* name, const char* dflt, bool saveDflt = true) { return Settings::current()(name, dflt, saveDflt); }
 
 	static void readAuto(const TString &fileName, EEnvLevel level = kEnvLocal)
-		{ Settings::global().readAuto(fileName, level); }
+		{ Settings::current().readAuto(fileName, level); }
+};
+
+
+///	@brief	Typed handle for a setting
+///
+///	Resolves the setting in the current Settings context on first use and
+///	caches the parsed value (per context and thread) until the context
+///	changes (see Settings::generation()), so repeated reads don't need a
+///	TEnv lookup. Reading never modifies the context, defaults are not
+///	saved to it (see Settings::saveDefaults()). Supported types are bool,
+///	int32_t, double and TString.
+///
+///	Example:
+///
+///		static Setting<int32_t> every("selector.log.every", 10000);
+///		if (entry % every == 0) ...
+template<typename T> class Setting: public Param, public Settings::Handle {
+protected:
+	size_t m_slot;
+	T m_dflt;
+
+	static void destroy(void *value) { delete static_cast<T*>(value); }
+
+	void resolve(Settings &settings, Settings::CacheSlot &slot) const;
+
+public:
+	const T& get() const {
+		Settings &settings = Settings::current();
+		Settings::CacheSlot &slot = settings.cacheSlot(m_slot);
+		if (slot.generation != settings.generation()) resolve(settings, slot);
+		return *static_cast<const T*>(slot.value);
+	}
+
+	operator const T& () const { return get(); }
+
+	///	@brief	Force the value to be looked up again on the next read in the current context (by this thread)
+	void invalidate() { Settings::current().cacheSlot(m_slot).generation = uint64_t(-1); }
+
+	virtual void saveDefault(Settings &settings) const { settings(m_name.Data(), m_dflt, true); }
+
+	Setting(const TString &name, const T &dflt)
+		: Param(name), m_slot(Settings::newCacheSlot()), m_dflt(dflt) { Settings::registerHandle(this); }
+
+	virtual ~Setting() { Settings::unregisterHandle(this); }
 };
 
 
+template<typename T> void Setting<T>::resolve(Settings &settings, Settings::CacheSlot &slot) const {
+	// Read the generation first, a concurrent change causes another lookup
+	uint64_t generation = settings.generation();
+	T value = settings(m_name.Data(), m_dflt, false);
+	if (slot.value == 0) {
+		slot.value = new T(value);
+		slot.destroy = &destroy;
+	} else *static_cast<T*>(slot.value) = value;
+	slot.generation = generation;
+}
+
+template<> inline void Setting<TString>::saveDefault(Settings &settings) const {
+	settings(m_name.Data(), m_dflt.Data(), true);
+}
+
+template<> inline void Setting<TString>::resolve(Settings &settings, Settings::CacheSlot &slot) const {
+	uint64_t generation = settings.generation();
+	TString value = settings(m_name.Data(), m_dflt.Data(), false);
+	if (slot.value == 0) {
+		slot.value = new TString(value);
+		slot.destroy = &destroy;
+	} else *static_cast<TString*>(slot.value) = value;
+	slot.generation = generation;
+}
+
+
 } // namespace froast
 
 
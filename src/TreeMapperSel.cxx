@@ -21,29 +21,49 @@
 #include <exception>
 #include <cassert>
 
+#include <RVersion.h>
+#include <RConfigure.h>
+#include <TROOT.h>
+
 #include "logging.h"
 #include "Settings.h"
+#include "OutputMerger.h"
 
 
 using namespace std;
 using namespace froast;
 
 
+namespace {
+
+// Read for every selector instance, i.e. once per input file in mapMulti
+Setting<int32_t> s_arenaBlockSize("froast.selector.arena.block.size", 64 * 1024);
+Setting<int32_t> s_arenaAlignment("froast.selector.arena.alignment", int32_t(block_allocator::default_alignment));
+Setting<int32_t> s_logIncreasedEvery("selector.logging.increased.every", 10000);
+
+} // namespace
+
+
 namespace froast {
 
 
-TreeMapperSel::TreeMapperSel(TTree *tree) {
+TreeMapperSel::TreeMapperSel(TTree *tree)
+	: entryArena(s_arenaBlockSize, s_arenaAlignment)
+{
 	// Internal
 
 	m_logCounter = 0;
+	m_loopStart = 0;
 
 	// Settings
 
+	settings = &Settings::current();
+
 	log_info("Input tree: %llu", (unsigned long long) tree);
 
 	sel_log_normal_level = string2LogLevel( GSettings::get("selector.logging.normal.level", logLevel2String( log_level() )) );
 	sel_log_increased_level = string2LogLevel( GSettings::get("selector.logging.increased.level", logLevel2String( LogLevel(std::max(int(sel_log_normal_level) - 10, 0)) )) );
-	sel_log_increased_every = GSettings::get("selector.logging.increased.every", 10000);
+	sel_log_increased_every = s_logIncreasedEvery;
 
 	output_level = 1;
 
@@ -51,6 +71,9 @@ TreeMapperSel::TreeMapperSel(TTree *tree) {
 	inputFile = 0;
 
 	outputTree = 0;
+	outputWriter = 0;
+	outputFlushEntries = 0;
+	outputNextFlush = 0;
 }
 
 
@@ -58,39 +81,121 @@ Int_t TreeMapperSel::GetEntry(Long64_t entry, Int_t getall) {
 	if (inputTree != 0) {
 		TTree *tree = inputTree->GetTree();
 		if (inputFile != tree->GetCurrentFile()) {
+			if (inputFile != 0) inputCache.fileEnd(inputTree);
+			inputCache.fileBegin(inputTree);
+			progress.file(inputTree);
 			inputFile = tree->GetCurrentFile();
 			log_info("Selector: Processing next file/tree: %s/%s", inputFile->GetName(), tree->GetName());
 			m_logCounter = 0;
 		}
 	}
 	log_debug("TreeMapperSel::GetEntry(%llu) [log every %llu]", (unsigned long long) entry, (unsigned long long) sel_log_increased_every);
+	if ((inputTree != 0) && inputManager.lazy() && (getall == 0)) {
+		// Branches will be read on access
+		inputManager.setEntry(entry);
+		return 0;
+	}
+	if ((inputTree != 0) && inputManager.pipelined() && (getall == 0)) {
+		// Entry has been read ahead by the input pipeline
+		inputManager.fetchEntry(inputTree->GetTree()->GetChainOffset() + entry);
+		return 0;
+	}
 	if (inputTree != 0) return inputTree->GetTree()->GetEntry(entry, getall);
 	else { assert(false); return 0; }
 }
 
 
-void TreeMapperSel::SlaveBegin(TTree *) {
+void TreeMapperSel::SlaveBegin(TTree *tree) {
+	Settings::Scope settingsScope(*settings);
 	log_info("TreeMapperSel::SlaveBegin(TTree *)");
+	PerfTimer beginTimer(string(ClassName()) + ".begin");
 	TString option = GetOption();
 
-	outputTree = new TTree("events", "Calibrated Events");
+	// With an active merger, write through a writer of our own, so several
+	// selectors can write to the same output file from different threads
+	if (OutputMerger::active() != 0) {
+		TDirectory *oldDir = gDirectory;
+		outputWriter = OutputMerger::active()->openWriter();
+		outputWriter->cd();
+		outputFlushEntries = GSettings::get("froast.output.merger.flush.entries", 100000);
+		outputNextFlush = outputFlushEntries;
+		outputTree = new TTree("events", "Calibrated Events");
+		oldDir->cd();
+	} else {
+		outputTree = new TTree("events", "Calibrated Events");
+	}
 	log_info("Created output TTree(\"%s\", \"%s\")", outputTree->GetName(), outputTree->GetTitle());
 
+	// Compress output baskets in parallel, using ROOT's implicit
+	// multi-threading. Opt-in, as it is process-wide and affects reading
+	// of the input (parallel unzipping) as well.
+	#if (ROOT_VERSION_CODE >= ROOT_VERSION(6,10,0)) && defined(R__USE_IMT)
+	if (GSettings::get("froast.output.imt", false)) {
+		if (!ROOT::IsImplicitMTEnabled()) ROOT::EnableImplicitMT(GSettings::get("froast.output.imt.threads", 0));
+		outputTree->SetImplicitMT(true);
+	}
+	#endif
+
+	outputClusters.outputTo(outputTree, tree);
 	outputManager.outputTo(outputTree, output_level);
+
+	progress.begin(ClassName(), (tree != 0) ? ProgressReporter::totalEntries(tree) : -1);
+	beginTimer.stop();
+	m_loopStart = PerfStats::now();
 }
 
 
 void TreeMapperSel::Init(TTree *tree) {
+	Settings::Scope settingsScope(*settings);
 	log_info("TreeMapperSel::Init(TTree *)");
 	if (!tree) return;
+	PerfTimer initTimer(string(ClassName()) + ".init");
 
 	inputTree = tree;
 	inputTree->SetMakeClass(1);
 	inputManager.inputFrom(tree);
+	window.inputFrom(inputManager);
+}
+
+
+Bool_t TreeMapperSel::Notify() {
+	Settings::Scope settingsScope(*settings);
+	// Normally drained on the last entry of the previous tree already, but
+	// entries may remain if that one wasn't processed (entry lists, ranges)
+	drainWindow(false);
+	// Input branches have to be re-resolved when a TChain switches trees
+	inputManager.notify();
+	return kTRUE;
+}
+
+
+Bool_t TreeMapperSel::processLoaded(Long64_t entry, bool inputCurrent) {
+	if ((inputTree != 0) && inputCurrent) outputClusters.inputEntry(inputTree, entry);
+
+	Bool_t result = ProcessEntry(entry);
+	entryArena.reset();
+
+	outputManager.autoTune();
+
+	if ((outputWriter != 0) && (outputTree->GetEntriesFast() >= outputNextFlush)) {
+		OutputMerger::active()->flush(outputWriter);
+		outputNextFlush = outputTree->GetEntriesFast() + outputFlushEntries;
+	}
+
+	return result;
+}
+
+
+void TreeMapperSel::drainWindow(bool inputCurrent) {
+	while (window.pending()) {
+		outputManager.clearData();
+		processLoaded(window.advance(), inputCurrent);
+	}
 }
 
 
 Bool_t TreeMapperSel::Process(Long64_t entry) {
+	Settings::Scope settingsScope(*settings);
 	TmpLogLevel tmpLog(m_logCounter++ % sel_log_increased_every == 0 ? sel_log_increased_level : sel_log_normal_level);
 
 	// Clear data in output
@@ -100,15 +205,55 @@ Bool_t TreeMapperSel::Process(Long64_t entry) {
 
 	// Load input entry
 	GetEntry(entry);
+	progress.entry();
+
+	bool lastInTree = (inputTree != 0) && (entry + 1 >= inputTree->GetTree()->GetEntries());
+
+	Bool_t result = kTRUE;
+	if (!window.active()) result = processLoaded(entry);
+	else {
+		// With lookahead, the entry in the middle of the window is processed
+		// (and its input restored) once its successors have been read
+		window.push(entry);
+		if (window.ready()) result = processLoaded(window.advance());
+		// Entries of a tree have to be processed before a TChain switches to
+		// the next one, the last ones don't get successors from the next tree
+		if (lastInTree) drainWindow();
+	}
 
-	return ProcessEntry(entry);
+	// The tree's cache statistics are gone once the TChain switched files
+	if (lastInTree) inputCache.fileEnd(inputTree);
+	return result;
 }
 
 
 void TreeMapperSel::SlaveTerminate() {
+	Settings::Scope settingsScope(*settings);
 	log_info("TreeMapperSel::SlaveTerminate()");
+	// The loop includes Notify() and reading of the input entries
+	PerfStats::record(string(ClassName()) + ".loop", PerfStats::now() - m_loopStart);
+	PerfTimer terminateTimer(string(ClassName()) + ".terminate");
+
+	// Process entries still waiting for successors in the event window
+	drainWindow();
 
-	outputTree->Write();
+	inputManager.finish();
+	if (inputTree != 0) inputCache.fileEnd(inputTree);
+	progress.end();
+
+	if (entryArena.blocks() > 0) {
+		log_debug("Entry arena: peak usage %li bytes, %li blocks with %li bytes in total",
+			long(entryArena.peak()), long(entryArena.blocks()), long(entryArena.capacity()));
+	}
+
+	if (outputWriter != 0) {
+		// Writes the output tree, and deletes it with the writer
+		OutputMerger::active()->closeWriter(outputWriter);
+		outputWriter = 0;
+		outputTree = 0;
+	} else {
+		outputTree->Write();
+	}
 
 	log_info("TreeMapperSel::SlaveTerminate() finished");
 }
@@ -23,6 +23,13 @@
 #include <TSelector.h>
 
 #include "BranchManager.h"
+#include "EventWindow.h"
+#include "InputCache.h"
+#include "OutputClusters.h"
+#include "PerfStats.h"
+#include "ProgressReporter.h"
+#include "Settings.h"
+#include "block_allocator.h"
 #include "logging.h"
 
 
@@ -35,26 +42,57 @@ protected:
 
 	Long64_t m_logCounter;
 
+	///	Start of the event loop (end of SlaveBegin), see PerfStats
+	double m_loopStart;
+
 	// Settings
 
+	///	Settings context the selector was created in, made current during
+	///	all selector callbacks, which ROOT may run on other threads (see
+	///	Settings::Scope). Selectors running concurrently have to be created
+	///	within separate contexts, otherwise they share this one.
+	froast::Settings *settings;
+
 	LogLevel sel_log_normal_level;
 	LogLevel sel_log_increased_level;
 	Int_t sel_log_increased_every;
 
 	Int_t output_level;
 
+	///	Scratch memory for temporaries within ProcessEntry(), reset after
+	///	each entry. Use directly, or via arena_allocator for STL containers,
+	///	e.g. std::vector<Hit, arena_allocator<Hit> > hits(entryArena);
+	///	Nothing allocated from it may be kept beyond the current entry.
+	froast::block_allocator entryArena;
+
 	// Input
 
 	froast::InputBranchManager inputManager;
 
 	TTree *inputTree;
 	TFile *inputFile;
+	InputCache inputCache;
+	ProgressReporter progress;
+
+	///	Values of neighbouring entries, see EventWindow. Configure (resize()
+	///	and add()) in the constructor of derived selectors.
+	froast::EventWindow window;
 
 	// Output
 
 	froast::OutputBranchManager outputManager;
 
 	TTree *outputTree;
+	OutputClusters outputClusters;
+	TDirectory *outputWriter;
+	Long64_t outputFlushEntries;
+	Long64_t outputNextFlush;
+
+	///	@param	inputCurrent	Entry belongs to the current tree of the input (for OutputClusters)
+	Bool_t processLoaded(Long64_t entry, bool inputCurrent = true);
+
+	///	Process all entries still waiting for successors in the event window
+	void drainWindow(bool inputCurrent = true);
 
 public:
 	TreeMapperSel(TTree *tree = 0);
@@ -65,6 +103,7 @@ public:
 
 	virtual void	SlaveBegin(TTree *tree);
 	virtual void	Init(TTree *tree);
+	virtual Bool_t  Notify();
 	virtual Bool_t  Process(Long64_t entry);
 	virtual void	SlaveTerminate();
 
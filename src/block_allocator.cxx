@@ -1,79 +1,201 @@
-// Copyright (C) 2010 by Ivan Vashchaev
-// Modified      2011 Oliver Schulz
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the "Software"), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is
-// furnished to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-// THE SOFTWARE.
-
-
-#include <memory.h>
-#include <algorithm>
-#include "block_allocator.h"
-
-
-namespace froast {
-
-
-block_allocator::block_allocator(size_t blocksize): m_head(0), m_blocksize(blocksize)
-{
-}
-
-block_allocator::~block_allocator()
-{
-	while (m_head)
-	{
-		block *temp = m_head->next;
-		::free(m_head);
-		m_head = temp;
-	}
-}
-
-void block_allocator::swap(block_allocator &rhs)
-{
-	std::swap(m_blocksize, rhs.m_blocksize);
-	std::swap(m_head, rhs.m_head);
-}
-
-void *block_allocator::malloc(size_t size)
-{
-	if ((m_head && m_head->used + size > m_head->size) || !m_head)
-	{
-		// calc needed size for allocation
-		size_t alloc_size = std::max(sizeof(block) + size, m_blocksize);
-
-		// create new block
-		char *buffer = (char *)::malloc(alloc_size);
-		block *b = reinterpret_cast<block *>(buffer);
-		b->size = alloc_size;
-		b->used = sizeof(block);
-		b->buffer = buffer;
-		b->next = m_head;
-		m_head = b;
-	}
-
-	void *ptr = m_head->buffer + m_head->used;
-	m_head->used += size;
-	return ptr;
-}
-
-void block_allocator::free()
-{
-	block_allocator(0).swap(*this);
-}
-
-
-} // namespace froast
+// Copyright (C) 2010 by Ivan Vashchaev
+// Modified      2011 Oliver Schulz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include <memory.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include <pthread.h>
+
+#include "block_allocator.h"
+
+
+namespace froast {
+
+
+namespace {
+
+char *align_up(char *p, size_t alignment)
+{
+	size_t misalignment = reinterpret_cast<size_t>(p) & (alignment - 1);
+	return misalignment ? p + (alignment - misalignment) : p;
+}
+
+pthread_key_t local_key;
+pthread_once_t local_key_once = PTHREAD_ONCE_INIT;
+
+void delete_local(void *allocator)
+{
+	delete static_cast<block_allocator *>(allocator);
+}
+
+void create_local_key()
+{
+	pthread_key_create(&local_key, delete_local);
+}
+
+const size_t local_blocksize = 64 * 1024;
+
+} // namespace
+
+
+block_allocator::block_allocator(size_t blocksize, size_t alignment)
+	: m_first(0), m_current(0), m_blocksize(blocksize), m_alignment(alignment),
+	  m_blocks(0), m_capacity(0), m_used(0), m_peak(0)
+{
+	if ((alignment == 0) || (alignment & (alignment - 1)))
+		throw std::invalid_argument("block_allocator: alignment must be a power of two");
+}
+
+block_allocator::~block_allocator()
+{
+	while (m_first)
+	{
+		block *temp = m_first->next;
+		::free(m_first);
+		m_first = temp;
+	}
+}
+
+block_allocator &block_allocator::local()
+{
+	pthread_once(&local_key_once, create_local_key);
+	block_allocator *allocator = static_cast<block_allocator *>(pthread_getspecific(local_key));
+	if (!allocator)
+	{
+		allocator = new block_allocator(local_blocksize);
+		pthread_setspecific(local_key, allocator);
+	}
+	return *allocator;
+}
+
+void block_allocator::swap(block_allocator &rhs)
+{
+	std::swap(m_blocksize, rhs.m_blocksize);
+	std::swap(m_alignment, rhs.m_alignment);
+	std::swap(m_first, rhs.m_first);
+	std::swap(m_current, rhs.m_current);
+	std::swap(m_blocks, rhs.m_blocks);
+	std::swap(m_capacity, rhs.m_capacity);
+	std::swap(m_used, rhs.m_used);
+	std::swap(m_peak, rhs.m_peak);
+}
+
+block_allocator::block *block_allocator::new_block(size_t size, size_t alignment)
+{
+	// calc needed size for allocation, with room to align the first allocation
+	size_t alloc_size = std::max(sizeof(block) + alignment + size, m_blocksize);
+
+	char *buffer = (char *)::malloc(alloc_size);
+	if (!buffer) throw std::bad_alloc();
+	block *b = reinterpret_cast<block *>(buffer);
+	b->size = alloc_size;
+	b->used = sizeof(block);
+	b->buffer = buffer;
+	b->next = 0;
+
+	++m_blocks;
+	m_capacity += alloc_size;
+	return b;
+}
+
+void *block_allocator::malloc(size_t size, size_t alignment)
+{
+	alignment = std::max(alignment, m_alignment);
+	while (true)
+	{
+		if (m_current)
+		{
+			char *ptr = align_up(m_current->buffer + m_current->used, alignment);
+			size_t end = (ptr - m_current->buffer) + size;
+			if (end <= m_current->size)
+			{
+				m_used += end - m_current->used;
+				m_peak = std::max(m_peak, m_used);
+				m_current->used = end;
+				return ptr;
+			}
+		}
+
+		// continue with the next (reused) block, if it is large enough;
+		// blocks after the current one are always unused
+		if (m_current && m_current->next && (sizeof(block) + alignment + size <= m_current->next->size))
+		{
+			m_current = m_current->next;
+			m_current->used = sizeof(block);
+			continue;
+		}
+
+		// insert a new block after the current one
+		block *b = new_block(size, alignment);
+		if (m_current)
+		{
+			b->next = m_current->next;
+			m_current->next = b;
+		}
+		else
+		{
+			b->next = m_first;
+			m_first = b;
+		}
+		m_current = b;
+	}
+}
+
+block_allocator::marker block_allocator::mark() const
+{
+	marker m;
+	m.current = m_current;
+	m.block_used = m_current ? m_current->used : 0;
+	m.used = m_used;
+	return m;
+}
+
+void block_allocator::rewind(const marker &m)
+{
+	if (m.current)
+	{
+		m_current = m.current;
+		m_current->used = m.block_used;
+		m_used = m.used;
+	}
+	else
+	{
+		reset();
+	}
+}
+
+void block_allocator::reset()
+{
+	if (m_first) m_first->used = sizeof(block);
+	m_current = m_first;
+	m_used = 0;
+}
+
+void block_allocator::free()
+{
+	block_allocator(m_blocksize, m_alignment).swap(*this);
+}
+
+
+} // namespace froast
@@ -1,65 +1,171 @@
-// Copyright (C) 2010 by Ivan Vashchaev
-// Modified      2011 Oliver Schulz
-//
-// Permission is hereby granted, free of charge, to any person obtaining a copy
-// of this software and associated documentation files (the "Software"), to deal
-// in the Software without restriction, including without limitation the rights
-// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-// copies of the Software, and to permit persons to whom the Software is
-// furnished to do so, subject to the following conditions:
-//
-// The above copyright notice and this permission notice shall be included in
-// all copies or substantial portions of the Software.
-//
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
-// THE SOFTWARE.
-
-
-#ifndef BLOCK_ALLOCATOR_H
-#define BLOCK_ALLOCATOR_H
-
-
-namespace froast {
-
-
-class block_allocator
-{
-private:
-	struct block
-	{
-		size_t size;
-		size_t used;
-		char *buffer;
-		block *next;
-	};
-
-	block *m_head;
-	size_t m_blocksize;
-
-	block_allocator(const block_allocator &);
-	block_allocator &operator=(block_allocator &);
-
-public:
-	block_allocator(size_t blocksize);
-	~block_allocator();
-
-	// exchange contents with rhs
-	void swap(block_allocator &rhs);
-
-	// allocate memory
-	void *malloc(size_t size);
-
-	// free all allocated blocks
-	void free();
-};
-
-
-} // namespace froast
-
-
-#endif
+// Copyright (C) 2010 by Ivan Vashchaev
+// Modified      2011 Oliver Schulz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#ifndef BLOCK_ALLOCATOR_H
+#define BLOCK_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+
+namespace froast {
+
+
+class block_allocator
+{
+private:
+	struct block
+	{
+		size_t size;
+		size_t used;
+		char *buffer;
+		block *next;
+	};
+
+	block *m_first;
+	block *m_current;
+	size_t m_blocksize;
+	size_t m_alignment;
+
+	// statistics
+	size_t m_blocks;
+	size_t m_capacity;
+	size_t m_used;
+	size_t m_peak;
+
+	block_allocator(const block_allocator &);
+	block_allocator &operator=(block_allocator &);
+
+	block *new_block(size_t size, size_t alignment);
+
+public:
+	// default alignment of allocations, sufficient for any fundamental type
+	static const size_t default_alignment = 16;
+
+	// position in the allocator, see mark() and rewind()
+	struct marker
+	{
+		block *current;
+		size_t block_used;
+		size_t used;
+	};
+
+	// marks the allocator on construction and rewinds it on destruction,
+	// e.g. for scratch memory taken from local()
+	class scope
+	{
+	private:
+		block_allocator &m_allocator;
+		marker m_marker;
+		scope(const scope &);
+		scope &operator=(const scope &);
+	public:
+		block_allocator &allocator() { return m_allocator; }
+		scope(block_allocator &a): m_allocator(a), m_marker(a.mark()) {}
+		~scope() { m_allocator.rewind(m_marker); }
+	};
+
+	// alignment must be a power of two
+	block_allocator(size_t blocksize, size_t alignment = default_alignment);
+	~block_allocator();
+
+	// allocator of the calling thread, created on first use and deleted
+	// when the thread exits
+	static block_allocator &local();
+
+	// exchange contents with rhs
+	void swap(block_allocator &rhs);
+
+	// allocate memory with the allocator's alignment
+	void *malloc(size_t size) { return malloc(size, m_alignment); }
+
+	// allocate memory with (at least) the given alignment, a power of two
+	void *malloc(size_t size, size_t alignment);
+
+	// current position, allocations made after it can be released by rewind()
+	marker mark() const;
+
+	// release all allocations made after mark m, keeping the blocks for reuse
+	void rewind(const marker &m);
+
+	// release all allocations, but keep the blocks for reuse
+	void reset();
+
+	// free all allocated blocks
+	void free();
+
+	size_t alignment() const { return m_alignment; }
+
+	// number and total size (in bytes) of the blocks held
+	size_t blocks() const { return m_blocks; }
+	size_t capacity() const { return m_capacity; }
+
+	// bytes currently allocated (including alignment padding)
+	size_t used() const { return m_used; }
+
+	// high-water mark of used(), since construction or reset_peak()
+	size_t peak() const { return m_peak; }
+	void reset_peak() { m_peak = m_used; }
+};
+
+
+// STL allocator using a block_allocator, deallocate() is a no-op.
+// Memory is released when the block_allocator is reset or freed, so
+// containers using it must not outlive that.
+template<typename T> class arena_allocator
+{
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<typename U> struct rebind { typedef arena_allocator<U> other; };
+
+	block_allocator *arena;
+
+	arena_allocator(block_allocator &a): arena(&a) {}
+	template<typename U> arena_allocator(const arena_allocator<U> &other): arena(other.arena) {}
+
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n, const void * = 0) { return static_cast<pointer>(arena->malloc(n * sizeof(T), __alignof__(T))); }
+	void deallocate(pointer, size_type) {}
+
+	size_type max_size() const { return size_type(-1) / sizeof(T); }
+
+	void construct(pointer p, const T &x) { new(static_cast<void *>(p)) T(x); }
+	void destroy(pointer p) { p->~T(); }
+};
+
+template<typename T, typename U> bool operator==(const arena_allocator<T> &a, const arena_allocator<U> &b) { return a.arena == b.arena; }
+template<typename T, typename U> bool operator!=(const arena_allocator<T> &a, const arena_allocator<U> &b) { return a.arena != b.arena; }
+
+
+} // namespace froast
+
+
+#endif
@@ -19,6 +19,7 @@
 #include <iostream>
 #include <fstream>
 #include <list>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -34,6 +35,10 @@
 #include "FroastTools.h"
 #include "Settings.h"
 #include "TreeEntryList.h"
+#include "ChainIndex.h"
+#include "InputCache.h"
+#include "LocalFile.h"
+#include "PerfStats.h"
 
 
 /*!	\mainpage	Programme to evaluate CPG pulse shape data
@@ -58,12 +63,24 @@ void handleOptionLogging(const char* optarg) {
 }
 
 
+void applyLoggingSettings() {
+	// Don't save defaults for logging settings:
+	string logLevel = Settings::global()("logging.level", "", false);
+	if (logLevel != "") log_level(logLevel.c_str());
+	log_format(string2LogFormat(Settings::global()("logging.format", "text", false)));
+	log_rate_limit(Settings::global()("logging.rate.limit", 0.0, false));
+	if (Settings::global()("logging.async", false, false))
+		log_async(true, size_t(max(1, Settings::global()("logging.async.buffer", int32_t(4096), false))));
+	else log_async(false);
+	PerfStats::logAtExit(Settings::global()("froast.perf.print", false, false));
+}
+
+
 void handleOptionConfig(const char* optarg) {
 	log_debug("Reading config/settings from \"%s\"", optarg);
 	Settings::global().readAuto(optarg);
-	// Don't save a default for logging setting:
-	string logLevel = Settings::global()("logging.level", "", false);
-	if (logLevel != "") log_level(logLevel.c_str());
+	applyLoggingSettings();
+	InputCache::configure();
 }
 
 
@@ -107,6 +124,8 @@ TChain* openTChain(const TString &inputSpec) {
 		for (int entry=0;entry<length;entry++) chain->Add(a[entry]->GetTitle());
 	}
 
+	ChainIndex::apply(chain);
+	LocalFile::applyTo(chain);
 	return chain;
 }
 
@@ -468,6 +487,9 @@ int main(int argc, char *argv[], char *envp[]) {
 		gROOT->ProcessLine("#include <vector>");
 
 		gSystem->SetProgname(PACKAGE_TARNAME);
+		LocalFile::registerPlugin();
+		applyLoggingSettings();
+		InputCache::configure();
 
 		string progName(argv[0]);
 
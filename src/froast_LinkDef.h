@@ -11,6 +11,8 @@
 
 // BranchManager.h
 
+#pragma link C++ class froast::BranchOutputParams-;
+
 #pragma link C++ class froast::ManagedBranch-;
 
 #pragma link C++ class froast::ScalarBranch<char>-;
@@ -33,19 +35,66 @@
 #pragma link C++ class froast::VectorBranch<double>-;
 #pragma link C++ class froast::VectorBranch<TString>-;
 
+#pragma link C++ class froast::BranchValueStore-;
 #pragma link C++ class froast::BranchManager-;
 #pragma link C++ class froast::InputBranchManager-;
 #pragma link C++ class froast::OutputBranchManager-;
 
+// ChainIndex.h
+#pragma link C++ class froast::ChainIndex-;
+
+// EntryPipeline.h
+#pragma link C++ class froast::EntryPipeline-;
+
+// EventWindow.h
+#pragma link C++ class froast::EventWindow-;
+
 // File.h
 #pragma link C++ class froast::File-;
 
+// FilePool.h
+#pragma link C++ class froast::FilePool-;
+#pragma link C++ class froast::PooledFile-;
+
+// FileScheduler.h
+#pragma link C++ class froast::FileScheduler-;
+
 // FroastTools.h
 #pragma link C++ class froast::FroastTools-;
 
+// InputCache.h
+#pragma link C++ class froast::InputCache-;
+
 // JSON.h
+#pragma link C++ class froast::JSONObjectBuilder-;
 #pragma link C++ class froast::JSON-;
 
+// JSONParser.h
+#pragma link C++ class froast::JSONHandler-;
+#pragma link C++ class froast::JSONParser-;
+
+// JSONWriter.h
+#pragma link C++ class froast::JSONWriter-;
+
+// LocalFile.h
+#pragma link C++ class froast::LocalFile-;
+
+// OutputClusters.h
+#pragma link C++ class froast::OutputClusters-;
+
+// OutputCompression.h
+#pragma link C++ class froast::OutputCompression-;
+
+// OutputMerger.h
+#pragma link C++ class froast::OutputMerger-;
+
+// PerfStats.h
+#pragma link C++ class froast::PerfStats-;
+#pragma link C++ class froast::PerfTimer-;
+
+// ProgressReporter.h
+#pragma link C++ class froast::ProgressReporter-;
+
 // Settings.h
 #pragma link C++ class froast::Param-;
 #pragma link C++ class froast::Settings-;
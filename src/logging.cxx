@@ -18,8 +18,20 @@
 #include "logging.h"
 
 #include <stdexcept>
+#include <vector>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "JSONWriter.h"
+
+#ifndef va_copy
+#define va_copy(dest, src) __builtin_va_copy(dest, src)
+#endif
 
 
 namespace froast {
@@ -27,6 +39,228 @@ namespace froast {
 
 LogLevel g_logLevel = LL_INFO;
 
+__thread bool t_logLevelOverride = false;
+__thread LogLevel t_logLevel = LL_INFO;
+
+
+} // namespace froast
+
+
+namespace {
+
+
+using namespace froast;
+
+
+// Messages up to this length are stored in the ring buffer slot itself
+const size_t slot_text_size = 472;
+
+struct LogSlot {
+	size_t sequence;
+	LogLevel level;
+	unsigned thread;
+	double time;
+	size_t length;
+	char *heapText;
+	char text[slot_text_size];
+};
+
+
+LogFormat g_logFormat = LF_TEXT;
+
+double g_rateLimit = 0;
+int64_t g_rateWindow = 0;
+size_t g_rateCount = 0;
+size_t g_rateSuppressed = 0;
+
+unsigned g_threadCounter = 0;
+__thread unsigned t_threadNumber = 0;
+
+// Bounded lock-free multi-producer queue with a single consumer (the
+// writer thread), after D. Vyukov: each slot carries a sequence number
+// that tells producers and consumer whose turn it is.
+LogSlot *g_ring = 0;
+size_t g_ringMask = 0;
+size_t g_enqueuePos = 0;
+size_t g_dequeuePos = 0;
+size_t g_dropped = 0;
+bool g_async = false;
+bool g_writerRunning = false;
+bool g_atExitRegistered = false;
+pthread_t g_writer;
+pthread_mutex_t g_configMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+double now() {
+	timeval tv;
+	gettimeofday(&tv, 0);
+	return double(tv.tv_sec) + 1e-6 * double(tv.tv_usec);
+}
+
+
+unsigned threadNumber() {
+	if (t_threadNumber == 0) t_threadNumber = __atomic_add_fetch(&g_threadCounter, 1, __ATOMIC_RELAXED);
+	return t_threadNumber;
+}
+
+
+const char* levelTag(LogLevel level) {
+	if (level >= LL_ERROR) return "!ERROR: ";
+	else if (level >= LL_WARN) return "!WARN: ";
+	else if (level >= LL_INFO) return "!INFO:  ";
+	else if (level >= LL_DEBUG) return "!DEBUG: ";
+	else return "!TRACE: ";
+}
+
+
+const char* levelName(LogLevel level) {
+	if (level >= LL_ERROR) return "ERROR";
+	else if (level >= LL_WARN) return "WARN";
+	else if (level >= LL_INFO) return "INFO";
+	else if (level >= LL_DEBUG) return "DEBUG";
+	else return "TRACE";
+}
+
+
+void writeMessage(LogLevel level, double time, unsigned thread, const char *text, size_t length) {
+	if (__atomic_load_n(&g_logFormat, __ATOMIC_RELAXED) == LF_JSON) {
+		JSONWriter json(length + 128);
+		json.beginObject();
+		json.key("time"); json.floatValue(time);
+		json.key("level"); json.stringValue(levelName(level));
+		json.key("thread"); json.intValue(thread);
+		json.key("message"); json.stringValue(text, length);
+		json.endObject();
+		flockfile(stderr);
+		fwrite(json.data(), 1, json.size(), stderr);
+		putc_unlocked('\n', stderr);
+		funlockfile(stderr);
+	} else {
+		const char *tag = levelTag(level);
+		flockfile(stderr);
+		fwrite(tag, 1, strlen(tag), stderr);
+		fwrite(text, 1, length, stderr);
+		putc_unlocked('\n', stderr);
+		funlockfile(stderr);
+	}
+}
+
+
+void writeNotice(const char *fmt, size_t count) {
+	char text[128];
+	int n = snprintf(text, sizeof(text), fmt, (unsigned long) count);
+	writeMessage(LL_WARN, now(), threadNumber(), text, size_t(n));
+}
+
+
+bool enqueue(LogLevel level, double time, unsigned thread, const char *text, size_t length, char *heapText) {
+	size_t pos = __atomic_load_n(&g_enqueuePos, __ATOMIC_RELAXED);
+	LogSlot *slot;
+	while (true) {
+		slot = &g_ring[pos & g_ringMask];
+		size_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+		intptr_t diff = intptr_t(seq) - intptr_t(pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&g_enqueuePos, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		} else if (diff < 0) {
+			return false; // full
+		} else {
+			pos = __atomic_load_n(&g_enqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+	slot->level = level;
+	slot->thread = thread;
+	slot->time = time;
+	slot->length = length;
+	slot->heapText = heapText;
+	if (heapText == 0) memcpy(slot->text, text, length);
+	__atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+
+// Only called by one thread at a time (the writer, or the thread
+// stopping it after the writer has finished)
+bool drain() {
+	bool any = false;
+	while (true) {
+		size_t pos = g_dequeuePos;
+		LogSlot *slot = &g_ring[pos & g_ringMask];
+		if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) break;
+		const char *text = (slot->heapText != 0) ? slot->heapText : slot->text;
+		writeMessage(slot->level, slot->time, slot->thread, text, slot->length);
+		free(slot->heapText);
+		__atomic_store_n(&slot->sequence, pos + g_ringMask + 1, __ATOMIC_RELEASE);
+		__atomic_store_n(&g_dequeuePos, pos + 1, __ATOMIC_RELEASE);
+		any = true;
+	}
+	size_t dropped = __atomic_exchange_n(&g_dropped, 0, __ATOMIC_RELAXED);
+	if (dropped > 0) writeNotice("%lu log messages dropped, log buffer full", dropped);
+	return any;
+}
+
+
+void* writerMain(void *) {
+	timespec idle = { 0, 1000000 };
+	while (true) {
+		if (drain()) continue;
+		fflush(stderr);
+		if (!__atomic_load_n(&g_writerRunning, __ATOMIC_ACQUIRE)) break;
+		nanosleep(&idle, 0);
+	}
+	return 0;
+}
+
+
+void stopWriter() {
+	pthread_mutex_lock(&g_configMutex);
+	if (__atomic_load_n(&g_async, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&g_async, false, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		__atomic_store_n(&g_writerRunning, false, __ATOMIC_RELEASE);
+		pthread_join(g_writer, 0);
+		drain();
+		fflush(stderr);
+	}
+	pthread_mutex_unlock(&g_configMutex);
+}
+
+
+// For producers that enqueued while the writer was being stopped: the
+// message may have missed the final drain of stopWriter()
+void drainStopped() {
+	pthread_mutex_lock(&g_configMutex);
+	if (!__atomic_load_n(&g_async, __ATOMIC_RELAXED)) {
+		drain();
+		fflush(stderr);
+	}
+	pthread_mutex_unlock(&g_configMutex);
+}
+
+
+// Fixed one-second windows, approximate under contention
+bool rateAllowed(LogLevel level, double time) {
+	double limit;
+	__atomic_load(&g_rateLimit, &limit, __ATOMIC_RELAXED);
+	if ((limit <= 0) || (level >= LL_ERROR)) return true;
+	int64_t window = int64_t(time);
+	int64_t current = __atomic_load_n(&g_rateWindow, __ATOMIC_RELAXED);
+	if ((window != current) && __atomic_compare_exchange_n(&g_rateWindow, &current, window, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&g_rateCount, 0, __ATOMIC_RELAXED);
+		size_t suppressed = __atomic_exchange_n(&g_rateSuppressed, 0, __ATOMIC_RELAXED);
+		if (suppressed > 0) writeNotice("%lu log messages suppressed by rate limit", suppressed);
+	}
+	if (double(__atomic_fetch_add(&g_rateCount, 1, __ATOMIC_RELAXED)) < limit) return true;
+	__atomic_add_fetch(&g_rateSuppressed, 1, __ATOMIC_RELAXED);
+	return false;
+}
+
+
+} // namespace
+
+
+namespace froast {
+
 
 void log_level(LogLevel level)
 	{ g_logLevel = level; }
@@ -38,6 +272,15 @@ void log_level(const std::string &level)
 	{ log_level(level.c_str()); }
 
 
+void log_thread_level(LogLevel level) {
+	t_logLevel = level;
+	t_logLevelOverride = true;
+}
+
+void log_thread_level_reset()
+	{ t_logLevelOverride = false; }
+
+
 LogLevel string2LogLevel(const char *level) {
 	if      (strncasecmp(level, "off",   6) == 0) return LL_OFF;
 	else if (strncasecmp(level, "trace", 6) == 0) return LL_TRACE;
@@ -61,19 +304,121 @@ const char* logLevel2String(LogLevel level) {
 }
 
 
-void v_log_generic_impl(const char* tag, const char *fmt, va_list argp) {
-	vfprintf(stderr, (std::string(tag) + fmt + "\n").c_str(), argp);
+LogFormat string2LogFormat(const char *format) {
+	if (strcasecmp(format, "text") == 0) return LF_TEXT;
+	else if (strcasecmp(format, "json") == 0) return LF_JSON;
+	else throw std::invalid_argument(std::string("Invalid logging format name \"") + format + "\"");
 }
 
-void log_trace_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl("!TRACE: ", fmt, argp);	va_end(argp); }
 
-void log_debug_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl("!DEBUG: ", fmt, argp);	va_end(argp); }
+void log_async(bool enable, size_t capacity) {
+	if (!enable) { stopWriter(); return; }
 
-void log_info_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl("!INFO:  ", fmt, argp);	va_end(argp); }
+	pthread_mutex_lock(&g_configMutex);
+	if (!__atomic_load_n(&g_async, __ATOMIC_RELAXED)) {
+		size_t size = 2;
+		while (size < capacity) size *= 2;
+		// A previous ring is not freed, late producers may still see it
+		if ((g_ring == 0) || (g_ringMask + 1 != size)) {
+			g_ring = new LogSlot[size];
+			for (size_t i = 0; i < size; ++i) g_ring[i].sequence = i;
+			g_ringMask = size - 1;
+			g_enqueuePos = 0;
+			g_dequeuePos = 0;
+		}
+		__atomic_store_n(&g_writerRunning, true, __ATOMIC_RELEASE);
+		if (pthread_create(&g_writer, 0, writerMain, 0) != 0) {
+			pthread_mutex_unlock(&g_configMutex);
+			throw std::runtime_error("Can't start log writer thread");
+		}
+		__atomic_store_n(&g_async, true, __ATOMIC_RELEASE);
+		if (!g_atExitRegistered) { atexit(stopWriter); g_atExitRegistered = true; }
+	}
+	pthread_mutex_unlock(&g_configMutex);
+}
+
+
+void log_format(LogFormat format)
+	{ __atomic_store_n(&g_logFormat, format, __ATOMIC_RELAXED); }
 
-void log_warn_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl("!WARN: ", fmt, argp);	va_end(argp); }
 
-void log_error_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl("!ERROR: ", fmt, argp);	va_end(argp); }
+void log_rate_limit(double messagesPerSecond)
+	{ __atomic_store(&g_rateLimit, &messagesPerSecond, __ATOMIC_RELAXED); }
+
+
+void log_flush() {
+	if (__atomic_load_n(&g_async, __ATOMIC_ACQUIRE)) {
+		size_t target = __atomic_load_n(&g_enqueuePos, __ATOMIC_ACQUIRE);
+		timespec wait = { 0, 1000000 };
+		while ((intptr_t(__atomic_load_n(&g_dequeuePos, __ATOMIC_ACQUIRE)) - intptr_t(target) < 0)
+			&& __atomic_load_n(&g_async, __ATOMIC_ACQUIRE))
+			nanosleep(&wait, 0);
+	}
+	fflush(stderr);
+}
+
+
+void v_log_generic_impl(LogLevel level, const char *fmt, va_list argp) {
+	double time = now();
+	if (!rateAllowed(level, time)) return;
+
+	char buffer[1024];
+	char *heapText = 0;
+	va_list argCopy;
+	va_copy(argCopy, argp);
+	int n = vsnprintf(buffer, sizeof(buffer), fmt, argp);
+	if (n < 0) n = 0;
+	size_t length = size_t(n);
+	if (length >= sizeof(buffer)) {
+		heapText = static_cast<char*>(malloc(length + 1));
+		if (heapText != 0) vsnprintf(heapText, length + 1, fmt, argCopy);
+		else length = sizeof(buffer) - 1;
+	}
+	va_end(argCopy);
+	const char *text = (heapText != 0) ? heapText : buffer;
+
+	if (__atomic_load_n(&g_async, __ATOMIC_ACQUIRE)) {
+		if ((length > slot_text_size) && (heapText == 0)) {
+			// Too long for the slot, but formatted into the stack buffer
+			heapText = static_cast<char*>(malloc(length + 1));
+			if (heapText != 0) { memcpy(heapText, buffer, length); text = heapText; }
+			else length = slot_text_size;
+		}
+		if (enqueue(level, time, threadNumber(), text, length, heapText)) {
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (!__atomic_load_n(&g_async, __ATOMIC_SEQ_CST)) drainStopped();
+			return;
+		}
+		if (level < LL_ERROR) {
+			__atomic_add_fetch(&g_dropped, 1, __ATOMIC_RELAXED);
+			free(heapText);
+			return;
+		}
+	}
+	writeMessage(level, time, threadNumber(), text, length);
+	free(heapText);
+}
+
+void log_trace_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl(LL_TRACE, fmt, argp);	va_end(argp); }
+
+void log_debug_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl(LL_DEBUG, fmt, argp);	va_end(argp); }
+
+void log_info_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl(LL_INFO, fmt, argp);	va_end(argp); }
+
+void log_warn_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl(LL_WARN, fmt, argp);	va_end(argp); }
+
+void log_error_impl(const char *fmt, ...) { va_list argp; va_start(argp, fmt); v_log_generic_impl(LL_ERROR, fmt, argp);	va_end(argp); }
+
+
+TmpLogLevel::TmpLogLevel(LogLevel level)
+	: m_storedOverride(t_logLevelOverride), m_storedLogLevel(t_logLevel)
+	{ log_thread_level(level); }
+
+
+TmpLogLevel::~TmpLogLevel() {
+	t_logLevel = m_storedLogLevel;
+	t_logLevelOverride = m_storedOverride;
+}
 
 
 } // namespace froast
@@ -36,9 +36,24 @@ enum LogLevel {
 	LL_OFF   = 0xffffffffl
 };
 
+enum LogFormat {
+	LF_TEXT = 0,
+	LF_JSON = 1
+};
+
 extern LogLevel g_logLevel;
 
-inline LogLevel log_level() { return g_logLevel; }
+#ifndef __CINT__
+extern __thread bool t_logLevelOverride;
+extern __thread LogLevel t_logLevel;
+
+///	@brief	Log level of the current thread (thread-local override or global level)
+inline LogLevel log_level() { return t_logLevelOverride ? t_logLevel : g_logLevel; }
+#else
+LogLevel log_level();
+#endif
+
+///	@brief	Set the global log level
 void log_level(LogLevel level);
 void log_level(const char* level);
 void log_level(const std::string &level);
@@ -48,11 +63,40 @@ const char* logLevel2String(LogLevel level);
 
 void logLevelName(LogLevel level);
 
-inline bool log_enabled(LogLevel level) { return level >= g_logLevel; }
+inline bool log_enabled(LogLevel level) { return level >= log_level(); }
 
 inline void log_to(std::ostream &stream);
 
-void v_log_generic_impl(const char* tag, const char *fmt, va_list argp);
+///	@brief	Override the log level for the current thread only
+void log_thread_level(LogLevel level);
+
+///	@brief	Remove the log level override of the current thread
+void log_thread_level_reset();
+
+///	@brief	Write log messages asynchronously
+///
+///	Messages are formatted by the logging thread and passed to a
+///	background writer through a lock-free ring buffer of the given
+///	capacity (in messages), so logging never waits for stderr. If the
+///	buffer is full, messages are dropped and counted, except errors,
+///	which are then written directly. Disabling flushes all pending messages.
+void log_async(bool enable, size_t capacity = 4096);
+
+///	@brief	Output format, plain text (default) or one JSON object per line
+void log_format(LogFormat format);
+LogFormat string2LogFormat(const char *format);
+
+///	@brief	Limit the rate of log messages (per second, 0 for no limit)
+///
+///	Messages exceeding the limit are dropped and counted. Errors are
+///	never dropped.
+void log_rate_limit(double messagesPerSecond);
+
+///	@brief	Wait until all pending asynchronous messages have been written
+void log_flush();
+
+void v_log_generic_impl(LogLevel level, const char *fmt, va_list argp);
+
 
 void log_trace_impl(const char *fmt, ...);
 void log_debug_impl(const char *fmt, ...);
@@ -63,29 +107,26 @@ void log_error_impl(const char *fmt, ...);
 inline void log_nothing_impl() {}
 
 
+///	@brief	Temporarily overrides the log level of the current thread
 class TmpLogLevel {
 protected:
+	bool m_storedOverride;
 	LogLevel m_storedLogLevel;
 
 public:
-	TmpLogLevel(LogLevel level) {
-		m_storedLogLevel = log_level();
-		log_level(level);
-	}
-
-	virtual ~TmpLogLevel()
-		{ log_level(m_storedLogLevel); }
+	TmpLogLevel(LogLevel level);
+	virtual ~TmpLogLevel();
 };
 
 
 } // namespace froast
 
 
-#define log_trace(...) ((froast::LL_TRACE >= froast::g_logLevel) ? froast::log_trace_impl(__VA_ARGS__) : froast::log_nothing_impl())
-#define log_debug(...) ((froast::LL_DEBUG >= froast::g_logLevel) ? froast::log_debug_impl(__VA_ARGS__) : froast::log_nothing_impl())
-#define log_info(...) ((froast::LL_INFO >= froast::g_logLevel) ? froast::log_info_impl(__VA_ARGS__) : froast::log_nothing_impl())
-#define log_warn(...) ((froast::LL_WARN >= froast::g_logLevel) ? froast::log_warn_impl(__VA_ARGS__) : froast::log_nothing_impl())
-#define log_error(...) ((froast::LL_ERROR >= froast::g_logLevel) ? froast::log_error_impl(__VA_ARGS__) : froast::log_nothing_impl())
+#define log_trace(...) (froast::log_enabled(froast::LL_TRACE) ? froast::log_trace_impl(__VA_ARGS__) : froast::log_nothing_impl())
+#define log_debug(...) (froast::log_enabled(froast::LL_DEBUG) ? froast::log_debug_impl(__VA_ARGS__) : froast::log_nothing_impl())
+#define log_info(...) (froast::log_enabled(froast::LL_INFO) ? froast::log_info_impl(__VA_ARGS__) : froast::log_nothing_impl())
+#define log_warn(...) (froast::log_enabled(froast::LL_WARN) ? froast::log_warn_impl(__VA_ARGS__) : froast::log_nothing_impl())
+#define log_error(...) (froast::log_enabled(froast::LL_ERROR) ? froast::log_error_impl(__VA_ARGS__) : froast::log_nothing_impl())
 
 
 #endif // FROAST_LOGGING_H
@@ -0,0 +1,97 @@
+// Copyright (C) 2026 Oliver Schulz <oliver.schulz@tu-dortmund.de>
+
+// This is free software; you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+
+
+#ifndef FROAST_SPSC_QUEUE_H
+#define FROAST_SPSC_QUEUE_H
+
+#include <vector>
+#include <cstddef>
+
+
+namespace froast {
+
+
+///	@brief	Bounded lock-free queue for one producer and one consumer thread
+///
+///	try_push() must only be called by the producer, try_pop() only by the
+///	consumer. Both fail instead of blocking, so callers can implement their
+///	own waiting (and back-pressure) strategy. The capacity is rounded up to
+///	a power of two.
+
+template<typename T> class spsc_queue
+{
+private:
+	std::vector<T> m_buffer;
+	size_t m_mask;
+
+	// Keep the consumer and producer positions on separate cache lines:
+	char m_pad0[64];
+	size_t m_head; // next element to pop, written by the consumer only
+	char m_pad1[64];
+	size_t m_tail; // next element to push, written by the producer only
+	char m_pad2[64];
+
+	spsc_queue(const spsc_queue &);
+	spsc_queue &operator=(const spsc_queue &);
+
+	static size_t load_acquire(const size_t *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+	static void store_release(size_t *p, size_t x) { __atomic_store_n(p, x, __ATOMIC_RELEASE); }
+
+public:
+	size_t capacity() const { return m_mask + 1; }
+
+	// approximate, unless called by the producer or the consumer
+	size_t size() const { return load_acquire(&m_tail) - load_acquire(&m_head); }
+
+	bool empty() const { return size() == 0; }
+
+	// append x, returns false if the queue is full
+	bool try_push(const T &x)
+	{
+		size_t tail = m_tail;
+		if (tail - load_acquire(&m_head) > m_mask) return false;
+		m_buffer[tail & m_mask] = x;
+		store_release(&m_tail, tail + 1);
+		return true;
+	}
+
+	// remove the oldest element into x, returns false if the queue is empty
+	bool try_pop(T &x)
+	{
+		size_t head = m_head;
+		if (head == load_acquire(&m_tail)) return false;
+		x = m_buffer[head & m_mask];
+		store_release(&m_head, head + 1);
+		return true;
+	}
+
+	spsc_queue(size_t capacity)
+		: m_mask(0), m_head(0), m_tail(0)
+	{
+		size_t n = 1;
+		while (n < capacity) n <<= 1;
+		m_buffer.resize(n);
+		m_mask = n - 1;
+	}
+};
+
+
+} // namespace froast
+
+
+#endif // FROAST_SPSC_QUEUE_H